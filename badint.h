@@ -8,15 +8,8 @@
 
 
 extern long badcount;
-extern long badcount_rxc;
-extern long badcount_udre;
 extern long badcount_txc;
-extern long badcount_timer2_comp;
 extern long badcount_timer2_ovf;
-extern long badcount_timer1_capt;
-extern long badcount_timer1_compa;
-extern long badcount_timer1_compb;
-extern long badcount_timer1_ovf;
 extern long badcount_timer0_ovf;
 extern long badcount_int1;
 extern long badcount_int2;
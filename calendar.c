@@ -0,0 +1,162 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "telegram.h"
+#include "calendar.h"
+
+
+/*
+ * Quarzuhr fuer den Holdover: zaehlt die zuletzt dekodierte
+ * Zeitinformation minutenweise weiter, mit Tages-, Monats- und
+ * Jahreswechsel (2000..2099, Schaltjahr alle vier Jahre) und der zur
+ * vollen Stunde angekuendigten Umstellung MEZ/MESZ.  Die Felder bleiben
+ * Ziffernzeichen wie vom Decoder geliefert.
+ */
+
+
+static uint8_t get2 (const char *digits)
+{
+  return (digits[0] - '0') * 10 + (digits[1] - '0');
+}
+
+
+static void set2 (char *digits, uint8_t v)
+{
+  digits[0] = '0';
+  while (v >= 10)
+  {
+    v -= 10;
+    ++digits[0];
+  };
+  digits[1] = '0' + v;
+}
+
+
+static uint8_t days_in_month (uint8_t mon, uint8_t yr)
+{
+  static const __flash uint8_t days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+  if (mon == 2 && yr % 4 == 0)
+  {
+    return 29;
+  };
+  return mon >= 1 && mon <= 12 ? days[mon - 1] : 31;
+}
+
+
+static void inc_day (struct TimeInfo *ti)
+{
+  uint8_t day = get2 (ti->day), mon = get2 (ti->mon), yr = get2 (ti->yr);
+
+  /* Wochentag 1 = Montag .. 7 = Sonntag */
+  ti->wday[0] = ti->wday[0] >= '7' ? '1' : ti->wday[0] + 1;
+
+  if (++day > days_in_month (mon, yr))
+  {
+    day = 1;
+    if (++mon > 12)
+    {
+      mon = 1;
+      yr = yr >= 99 ? 0 : yr + 1;
+    }
+  };
+  set2 (ti->day, day);
+  set2 (ti->mon, mon);
+  set2 (ti->yr, yr);
+}
+
+
+static void dec_day (struct TimeInfo *ti)
+{
+  uint8_t day = get2 (ti->day), mon = get2 (ti->mon), yr = get2 (ti->yr);
+
+  ti->wday[0] = ti->wday[0] <= '1' ? '7' : ti->wday[0] - 1;
+
+  if (--day < 1)
+  {
+    if (--mon < 1)
+    {
+      mon = 12;
+      yr = yr == 0 ? 99 : yr - 1;
+    };
+    day = days_in_month (mon, yr);
+  };
+  set2 (ti->day, day);
+  set2 (ti->mon, mon);
+  set2 (ti->yr, yr);
+}
+
+
+/*
+ * A2 steht auch noch im Rahmen fuer Minute 00, die Schaltsekunde ist
+ * dann aber schon vorbei.  Gilt fuer empfangene und fortgezaehlte Minuten.
+ */
+void calendar_leap_done (struct TimeInfo *ti)
+{
+  if (ti->min[0] == '0' && ti->min[1] == '0')
+  {
+    ti->leap = false;
+  }
+}
+
+
+void calendar_inc_min (struct TimeInfo *ti)
+{
+  uint8_t min = get2 (ti->min);
+
+  if (++min < 60)
+  {
+    set2 (ti->min, min);
+    return;
+  };
+  set2 (ti->min, 0);
+
+  uint8_t hr = get2 (ti->hr) + 1;
+
+  /* Ankuendigungen gelten bis zur vollen Stunde */
+  if (ti->tz_change)
+  {
+    if (ti->cest && hr == 3)
+    {
+      --hr;             /* 03:00 MESZ -> 02:00 MEZ */
+      ti->cest = false;
+      ti->cet  = true;
+    }
+    else if (!ti->cest && hr == 2)
+    {
+      ++hr;             /* 02:00 MEZ -> 03:00 MESZ */
+      ti->cest = true;
+      ti->cet  = false;
+    };
+    ti->tz_change = false;
+  };
+  calendar_leap_done (ti);
+
+  if (hr >= 24)
+  {
+    hr -= 24;
+    inc_day (ti);
+  };
+  set2 (ti->hr, hr);
+}
+
+
+/* Lokalzeit MEZ/MESZ -> UTC, fuer Formate mit Weltzeit */
+void calendar_utc (struct TimeInfo *ti)
+{
+  const uint8_t offset = ti->cest ? 2 : 1;
+  uint8_t hr = get2 (ti->hr);
+
+  if (hr < offset)
+  {
+    hr += 24;
+    dec_day (ti);
+  };
+  set2 (ti->hr, hr - offset);
+}
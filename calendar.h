@@ -0,0 +1,18 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _CALENDAR_H
+#define _CALENDAR_H
+
+
+#include "telegram.h"
+
+
+extern void calendar_leap_done (struct TimeInfo *ti);
+extern void calendar_inc_min (struct TimeInfo *ti);
+extern void calendar_utc (struct TimeInfo *ti);
+
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "hal.h"
+#include "prof.h"
+#include "timer1.h"
+#include "uart.h"
+#include "telegram.h"
+#include "capture.h"
+
+
+/*
+ * Rohmitschnitt des Signals fuer die Wiedergabe im nativen Build
+ * (host/dcf77cap).  INT0 meldet jeden Pegelwechsel an PD2 mit
+ * Timer-1-Zeitstempel, die Hintergrundschleife sendet die Flanken in
+ * Bloecken.  Der Zeitstempel entsteht erst in der ISR und traegt deren
+ * Latenz; ICP1 und die Abtastung laufen unveraendert weiter.
+ */
+
+
+struct CaptureEdge
+{
+  uint32_t t;
+  bool level;
+};
+
+#define CBUF_ID         c_
+#define CBUF_LEN        CAPTURE_LEN
+#define CBUF_TYPE       struct CaptureEdge
+#include "cbuf.h"
+
+static struct c_CBuf capture_edges;
+static volatile uint8_t capture_lost;
+static uint32_t capture_last;
+
+const __flash uint16_t capture_ram = sizeof capture_edges;
+
+
+/*********************
+ * INT0, jede Flanke *
+ *********************/
+
+ISR (INT0_vect)
+{
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  if (c_full (&capture_edges))
+  {
+    capture_lost += capture_lost < UINT8_MAX;
+  }
+  else
+  {
+    c_put (&capture_edges, (struct CaptureEdge) { .t = timer1_get (), .level = hal_signal_state () });
+  };
+
+  prof_isr (PROF_INT0, tcnt1, 0);
+}
+
+
+void capture_start (void)
+{
+  cli ();
+  c_init (&capture_edges);
+  capture_lost = 0;
+  capture_last = timer1_get () - TIMER1VALUE_1S;
+  hal_int0 (true);
+  sei ();
+}
+
+
+void capture_stop (void)
+{
+  cli ();
+  hal_int0 (false);
+  sei ();
+}
+
+
+static uint16_t put (uint16_t crc, uint8_t b)
+{
+  uart_putc (b);
+  return telegram_crc16 (crc, b);
+}
+
+
+static uint16_t put_le (uint16_t crc, uint32_t v, uint8_t n)
+{
+  while (n--)
+  {
+    crc = put (crc, v);
+    v >>= 8;
+  };
+  return crc;
+}
+
+
+/* aus der Hintergrundschleife, sendet hoechstens einen Block */
+void capture_flush (void)
+{
+  cli ();
+  const uint8_t n = c_used (&capture_edges);
+  const uint32_t now = timer1_get ();
+  const uint32_t first = n ? c_peek (&capture_edges).t : now;
+  if (n == 0 && now - capture_last < TIMER1VALUE_1S)
+  {
+    sei ();
+    return;
+  };
+  const uint8_t lost = capture_lost;
+  capture_lost = 0;
+  sei ();
+  capture_last = now;
+
+  uint16_t crc = 0xFFFF;
+  uart_putc (CAP_SYNC0);
+  uart_putc (CAP_SYNC1);
+  crc = put (crc, n);
+  crc = put (crc, lost);
+  crc = put_le (crc, first, 4);
+
+  uint32_t prev = first;
+  for (uint8_t i = 0; i < n; ++i)
+  {
+    cli ();
+    const struct CaptureEdge e = c_get (&capture_edges);
+    sei ();
+
+    uint32_t v = (e.t - prev) << 1 | e.level;
+    prev = e.t;
+    while (v >= 0x80)
+    {
+      crc = put (crc, v | 0x80);
+      v >>= 7;
+    };
+    crc = put (crc, v);
+  };
+  put_le (crc, crc, 2);
+}
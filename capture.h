@@ -0,0 +1,41 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Ausgabe von capture_flush(), ein Block je Sekunde oder sobald
+ * Flanken anstehen, Zahlen little-endian:
+ *
+ *   0  CAP_SYNC0, CAP_SYNC1
+ *   2  Anzahl n
+ *   3  seit dem vorigen Block verlorene Flanken (bis 255)
+ *   4  Timer 1 (4) der ersten Flanke, ohne Flanken jetzt
+ *   8  n Flanken, je LEB128 von Abstand zur vorigen << 1 | Pegel
+ *      (die erste mit Abstand 0)
+ *   .. CRC-16 wie beim Binaertelegramm ab Byte 2
+ */
+#define CAP_SYNC0       0xA5
+#define CAP_SYNC1       0x3C
+#define CAP_HEAD        8
+
+/* Warteschlange der ISR, ein Platz bleibt frei */
+#define CAPTURE_LEN     8
+
+
+extern const __flash uint16_t capture_ram;
+
+extern void capture_start (void);
+extern void capture_stop (void);
+extern void capture_flush (void);
+
+
+#endif
@@ -82,8 +82,8 @@ int8_t cmdint_getline (const CmdIntCallback_t *callback,
 
 void cmdint (const CmdIntCallback_t *callback)
 {
-  static char backup[81];
-  char line[81];
+  static char backup[CMDINT_LINE];
+  char line[CMDINT_LINE];
   int8_t argc;
   char *argv[11];
   char *str1, *str2;
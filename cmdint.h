@@ -11,6 +11,10 @@
 #include <stdbool.h>
 
 
+/* Zeilenpuffer mit Abschluss, einmal statisch (Wiederholung) und einmal auf dem Stack */
+#define CMDINT_LINE     81
+
+
 struct CmdIntCallback
 {
   uint8_t (*getc_f) (void);
@@ -0,0 +1,188 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+
+#include "common.h"
+#include "hal.h"
+#include "uart.h"
+#include "timer1.h"
+#include "prof.h"
+#include "trace.h"
+#include "emit.h"
+
+
+/*
+ * Das vorab gerenderte Zeittelegramm wartet zurueckgehalten im
+ * UART-Puffer.  Timer 1 Compare A gibt das erste Zeichen um
+ * emit_offset µs nach der Sekundenmarke frei (negativ: davor).
+ * Die Sekundenmarke ist ein 32-Bit-Zeitstempel von Timer 1 aus main.c,
+ * die Statistik zaehlt in Timer-1-Takten.
+ */
+
+
+#ifndef EMIT_OFFSET
+#define EMIT_OFFSET     7812
+#endif
+
+/* Mindestabstand zum Freigabezeitpunkt */
+#define EMIT_MARGIN     US_TO_T1(500)
+
+
+static uint32_t ee_emit_offset EEMEM = UINT32_MAX;
+
+int32_t emit_offset;
+long emit_count, emit_late;
+int32_t emit_min, emit_max;
+int64_t emit_sum;     /* 32 Bit liefen nach etwa 6 Tagen ohne Abfrage ueber */
+
+static int32_t emit_t1;
+static uint32_t emit_boundary, emit_compare;
+static volatile bool emit_is_armed;
+
+
+/**************************
+ * Timer-1-Compare-A      *
+ **************************/
+
+static inline void compare_a (void)
+{
+  const uint32_t t = timer1_get ();
+
+  /* hoechstens ein frueher Match im Umlauf vor dem Zeitpunkt (timer1.c) */
+  if ((int32_t) (t - emit_compare) < 0)
+  {
+    return;
+  };
+
+  uart_release ();
+  timer1_compare_off (T1_COMPARE_A);
+  emit_is_armed = false;
+  trace_put (TR_EMIT, 0, 0, t);
+
+  const int32_t achieved = t - emit_boundary;
+  if (emit_count == 0 || achieved < emit_min)
+  {
+    emit_min = achieved;
+  };
+  if (emit_count == 0 || achieved > emit_max)
+  {
+    emit_max = achieved;
+  };
+  emit_sum += achieved;
+  ++emit_count;
+}
+
+
+ISR (TIMER1_COMPA_vect)
+{
+  const uint16_t latency = hal_latency_compa ();
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  compare_a ();
+
+  prof_isr (PROF_TIMER1_COMPA, tcnt1, latency);
+}
+
+
+void emit_clear_stat (void)
+{
+  cli ();
+  emit_count = emit_late = 0;
+  emit_min = emit_max = 0;
+  emit_sum = 0;
+  sei ();
+}
+
+
+bool emit_set_offset (int32_t us)
+{
+  if (us <= -1000000 || us >= 1000000)
+  {
+    return false;
+  };
+  emit_offset = us;
+  emit_t1 = US_TO_T1(us);
+  return true;
+}
+
+
+void emit_store (void)
+{
+  eeprom_update_dword (&ee_emit_offset, emit_offset);
+}
+
+
+void emit_init (void)
+{
+  const uint32_t ee = eeprom_read_dword (&ee_emit_offset);
+
+  if (ee == UINT32_MAX || !emit_set_offset ((int32_t) ee))
+  {
+    emit_set_offset (EMIT_OFFSET);
+  }
+}
+
+
+bool emit_armed (void)
+{
+  return emit_is_armed;
+}
+
+
+/* Freigabe fuer die Sekundenmarke boundary liegt noch in der Zukunft */
+bool emit_in_time (uint32_t boundary)
+{
+  return (int32_t) (boundary + emit_t1 - timer1_now ()) > EMIT_MARGIN;
+}
+
+
+/*
+ * Telegramm fuer die Sekundenmarke boundary ist noch freizugeben.  Die
+ * PLL darf die Marke seit der letzten Freigabe etwas verschoben haben.
+ * Eine verpasste Marke zaehlt einmal als verspaetet.
+ */
+bool emit_due (uint32_t boundary)
+{
+  const int32_t moved = boundary - emit_boundary;
+
+  if (-(int32_t) TIMER1VALUE_1S / 2 <= moved && moved <= (int32_t) TIMER1VALUE_1S / 2)
+  {
+    return false;
+  };
+  if (emit_in_time (boundary))
+  {
+    return true;
+  };
+  emit_boundary = boundary;
+  ++emit_late;
+  return false;
+}
+
+
+bool emit_arm (uint32_t boundary)
+{
+  const uint32_t compare = boundary + emit_t1;
+  bool armed;
+
+  cli ();
+  armed = (int32_t) (compare - timer1_get ()) >= EMIT_MARGIN;
+  if (armed)
+  {
+    emit_boundary = boundary;
+    emit_compare = compare;
+    emit_is_armed = true;
+    timer1_compare (T1_COMPARE_A, compare);
+  }
+  else
+  {
+    ++emit_late;
+  };
+  sei ();
+  return armed;
+}
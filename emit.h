@@ -0,0 +1,29 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _EMIT_H
+#define _EMIT_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+extern int32_t emit_offset;
+extern long emit_count, emit_late;
+extern int32_t emit_min, emit_max;
+extern int64_t emit_sum;
+
+extern void emit_init (void);
+extern bool emit_set_offset (int32_t us);
+extern void emit_store (void);
+extern void emit_clear_stat (void);
+extern bool emit_armed (void);
+extern bool emit_in_time (uint32_t boundary);
+extern bool emit_due (uint32_t boundary);
+extern bool emit_arm (uint32_t boundary);
+
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "frame.h"
+
+
+/*
+ * Tabellengesteuerter Decoder fuer die Sekunden 0..58.  Jede Zeile
+ * aus FRAME_LAYOUT sagt, wohin das Bit gehoert und was danach zu
+ * pruefen ist; BCD-Ziffern kommen mit dem niederwertigsten Bit zuerst,
+ * Gewicht 1 setzt die Ziffer deshalb auf '0' zurueck.
+ */
+
+
+static const __flash struct
+{
+  uint8_t ofs, op, chk, err;
+}
+frame_layout[] =
+{
+#define FRAME_ROW(state, o, p, c, e)    [state - START_OF_MINUTE] = { .ofs = o, .op = p, .chk = c, .err = e },
+  FRAME_LAYOUT(FRAME_ROW)
+#undef FRAME_ROW
+};
+
+_Static_assert (LENGTH (frame_layout) == 59, "DCF77-Rahmen hat 59 Datenbits");
+
+
+static uint8_t frame_parity;
+
+
+/* state START_OF_MINUTE..PARITY_DATE, liefert NO_ERROR oder den Fehler der Zeile */
+uint8_t frame_bit (struct TimeInfo *ti, uint8_t state, uint8_t bit)
+{
+  const uint8_t i = state - START_OF_MINUTE;
+  const uint8_t op = frame_layout[i].op;
+  uint8_t *const p = (uint8_t *) ti + frame_layout[i].ofs;
+
+  if (op & FB_FLAG)
+  {
+    *p = bit;
+  }
+  else if (op & FB_WEIGHT)
+  {
+    const uint8_t w = op & FB_WEIGHT;
+    *p = (w == 1 ? '0' : *p) | (bit ? w : 0);
+  };
+  if (op & FB_PARITY)
+  {
+    frame_parity ^= bit;
+  };
+
+  bool ok;
+  switch (frame_layout[i].chk)
+  {
+    case FC_NONE:
+      return NO_ERROR;
+
+    case FC_ZERO:
+      ok = bit == 0;
+      break;
+
+    case FC_ONE:
+      ok = bit == 1;
+      break;
+
+    case FC_CET:
+      ok = ti->cet != ti->cest;
+      break;
+
+    default:
+      ok = bit == frame_parity;
+      break;
+  };
+  frame_parity = 0;
+  return ok ? NO_ERROR : frame_layout[i].err;
+}
@@ -0,0 +1,134 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "telegram.h"
+
+
+/* Bitbedeutung einer Tabellenzeile */
+#define FB_WEIGHT       0x0F    /* BCD-Gewicht, Gewicht 1 beginnt die Ziffer */
+#define FB_FLAG         0x10    /* Merker setzen */
+#define FB_PARITY       0x20    /* zaehlt zur laufenden Paritaet */
+
+#define FB_OFS(f)       offsetof (struct TimeInfo, f)
+#define FB_BCD(w)       ((w) | FB_PARITY)
+
+
+/* Pruefung nach dem Speichern, danach beginnt die Paritaet neu */
+enum FrameCheck
+{
+  FC_NONE = 0,
+  FC_ZERO,              /* Bit muss 0 sein */
+  FC_ONE,               /* Bit muss 1 sein */
+  FC_CET,               /* MEZ und MESZ schliessen sich aus */
+  FC_PARITY,            /* gerade Paritaet */
+};
+
+
+enum FrameError
+{
+  NO_ERROR,
+  E_STATE,
+  E_START_OF_MINUTE,
+  E_END_OF_MINUTE,
+  E_NOT_END_OF_MINUTE,
+  E_CET_CEST,
+  E_START_TIME,
+  E_PARITY_MIN,
+  E_PARITY_HR,
+  E_PARITY_DATE,
+  E_BIT_STATE,
+  E_BIT_QUEUE,
+};
+
+
+/*
+ * Aufbau des DCF77-Rahmens, eine Zeile je Sekunde 0..58:
+ * Zustand, Ziel in struct TimeInfo, Art, Pruefung, Fehler.
+ * Sekunde 59 (Minutenmarke oder Schaltsekunde) bleibt main.c.
+ */
+#define FRAME_LAYOUT(X)                                                         \
+  X(START_OF_MINUTE,    0,              0,              FC_ZERO,   E_START_OF_MINUTE)   \
+  X(IGNORE_1,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_2,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_3,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_4,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_5,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_6,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_7,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_8,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_9,           0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_10,          0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_11,          0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_12,          0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_13,          0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_14,          0,              0,              FC_NONE,   NO_ERROR)    \
+  X(IGNORE_15,          0,              0,              FC_NONE,   NO_ERROR)    \
+  X(NEW_TZ,             FB_OFS(tz_change), FB_FLAG,     FC_NONE,   NO_ERROR)    \
+  X(CEST,               FB_OFS(cest),   FB_FLAG,        FC_NONE,   NO_ERROR)    \
+  X(CET,                FB_OFS(cet),    FB_FLAG,        FC_CET,    E_CET_CEST)  \
+  X(LEAP,               FB_OFS(leap),   FB_FLAG,        FC_NONE,   NO_ERROR)    \
+  X(START_TIME,         0,              0,              FC_ONE,    E_START_TIME) \
+  X(MIN_0,              FB_OFS(min[1]), FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(MIN_1,              FB_OFS(min[1]), FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(MIN_2,              FB_OFS(min[1]), FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(MIN_3,              FB_OFS(min[1]), FB_BCD(8),      FC_NONE,   NO_ERROR)    \
+  X(MIN_4,              FB_OFS(min[0]), FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(MIN_5,              FB_OFS(min[0]), FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(MIN_6,              FB_OFS(min[0]), FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(PARITY_MIN,         0,              0,              FC_PARITY, E_PARITY_MIN) \
+  X(HR_0,               FB_OFS(hr[1]),  FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(HR_1,               FB_OFS(hr[1]),  FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(HR_2,               FB_OFS(hr[1]),  FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(HR_3,               FB_OFS(hr[1]),  FB_BCD(8),      FC_NONE,   NO_ERROR)    \
+  X(HR_4,               FB_OFS(hr[0]),  FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(HR_5,               FB_OFS(hr[0]),  FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(PARITY_HR,          0,              0,              FC_PARITY, E_PARITY_HR) \
+  X(DAY_0,              FB_OFS(day[1]), FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(DAY_1,              FB_OFS(day[1]), FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(DAY_2,              FB_OFS(day[1]), FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(DAY_3,              FB_OFS(day[1]), FB_BCD(8),      FC_NONE,   NO_ERROR)    \
+  X(DAY_4,              FB_OFS(day[0]), FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(DAY_5,              FB_OFS(day[0]), FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(WDAY_0,             FB_OFS(wday[0]), FB_BCD(1),     FC_NONE,   NO_ERROR)    \
+  X(WDAY_1,             FB_OFS(wday[0]), FB_BCD(2),     FC_NONE,   NO_ERROR)    \
+  X(WDAY_2,             FB_OFS(wday[0]), FB_BCD(4),     FC_NONE,   NO_ERROR)    \
+  X(MON_0,              FB_OFS(mon[1]), FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(MON_1,              FB_OFS(mon[1]), FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(MON_2,              FB_OFS(mon[1]), FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(MON_3,              FB_OFS(mon[1]), FB_BCD(8),      FC_NONE,   NO_ERROR)    \
+  X(MON_4,              FB_OFS(mon[0]), FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(YR_0,               FB_OFS(yr[1]),  FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(YR_1,               FB_OFS(yr[1]),  FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(YR_2,               FB_OFS(yr[1]),  FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(YR_3,               FB_OFS(yr[1]),  FB_BCD(8),      FC_NONE,   NO_ERROR)    \
+  X(YR_4,               FB_OFS(yr[0]),  FB_BCD(1),      FC_NONE,   NO_ERROR)    \
+  X(YR_5,               FB_OFS(yr[0]),  FB_BCD(2),      FC_NONE,   NO_ERROR)    \
+  X(YR_6,               FB_OFS(yr[0]),  FB_BCD(4),      FC_NONE,   NO_ERROR)    \
+  X(YR_7,               FB_OFS(yr[0]),  FB_BCD(8),      FC_NONE,   NO_ERROR)    \
+  X(PARITY_DATE,        0,              0,              FC_PARITY, E_PARITY_DATE)
+
+
+#define FRAME_STATE(state, ofs, op, chk, err)   state,
+
+enum ProtocolState
+{
+  NOT_SYNCED = 0,
+  FRAME_LAYOUT(FRAME_STATE)
+  END_OF_MINUTE,
+};
+
+
+extern uint8_t frame_bit (struct TimeInfo *ti, uint8_t state, uint8_t bit);
+
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+
+#include "common.h"
+#include "defs.h"
+#include "switches.h"
+#include "hal.h"
+
+
+/******************
+ * Ein-/Ausgaenge *
+ ******************/
+
+void hal_init (void)
+{
+  /* Eingaenge DIP-Switches */
+  DDR_SWITCHES  &= ~MASK_SWITCHES;
+  PORT_SWITCHES |=  MASK_SWITCHES;
+
+  /* Ausgang PDN */
+  DDR_PDN  |=  MASK_PDN;
+  PORT_PDN |=  MASK_PDN;
+}
+
+
+/*********
+ * Timer *
+ *********/
+
+void hal_timer_init (void)
+{
+#if TIMER0PRESCALE != 1024
+#error
+#endif
+  TCCR0  = _BV(WGM01) | _BV(CS02) | _BV(CS00);
+  OCR0   = TIMER0CMPVALUE - 1;                  /* CTC: Periode OCR0+1 */
+  TCNT0  = 0;
+
+#if TIMER1PRESCALE != 8 || F_CPU / TIMER1PRESCALE != TIMER1VALUE_1S
+#error
+#endif
+  /* frei laufend, Input Capture mit Rauschunterdrueckung, fallend */
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(CS11);
+
+  /* gemeinsamen Vorteiler direkt vor TCNT1 = 0 neu starten: Timer 0 zaehlt bei TCNT1 % 128 == 0 */
+  SFIOR |= _BV(PSR10);
+  TCNT1  = 0;
+
+  TIMSK  = _BV(OCIE0);
+}
+
+
+/***************************************
+ * Timer 1 Input Capture und Ueberlauf *
+ ***************************************/
+
+void hal_capture_init (void)
+{
+  DDRD  &= ~_BV(PD6);
+  TIFR   =  _BV(ICF1) | _BV(TOV1);
+  TIMSK |=  _BV(TICIE1) | _BV(TOIE1);
+}
+
+
+/**************************
+ * Sekundenimpuls an OC1B *
+ **************************/
+
+void hal_pps_init (void)
+{
+  /* PD4 Ausgang, Compare B loescht zunaechst nur, den Interrupt gibt timer1.c frei */
+  PORTD  &= ~_BV(PD4);
+  DDRD   |=  _BV(PD4);
+  TCCR1A  =  _BV(COM1B1);
+}
+
+
+/*********************
+ * Timer 2 Abtastung *
+ *********************/
+
+/* TCNT1 beim Start des Vorteilers von Timer 2, fuer hal_latency_t2() */
+uint8_t hal_t2_phase;
+
+
+void hal_sample_init (void)
+{
+#if F_CPU / 64 / 64 != 1024
+#error
+#endif
+  /* CTC, Periode 64, clk/64 erst mit hal_sample_run(): 1024 Hz */
+  TCCR2  = _BV(WGM21);
+  OCR2   = 64 - 1;
+  TCNT2  = 0;
+}
+
+
+/***************
+ * Stromsparen *
+ ***************/
+
+void hal_power_init (void)
+{
+  /* Analogkomparator und ADC werden nicht gebraucht */
+  ACSR   = _BV(ACD);
+  ADCSRA = 0;
+}
+
+
+/********
+ * UART *
+ ********/
+
+static const uint8_t baudrates[][2] =
+{
+#define BAUD    9600
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    4800
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    2400
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    1200
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    600
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    300
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    300
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+
+#define BAUD    300
+#include <util/setbaud.h>
+#if USE2X
+#error
+#endif
+  { UBRRH_VALUE, UBRRL_VALUE },
+#undef BAUD
+};
+
+
+void hal_uart_init (uint8_t baudrate, uint8_t databits, uint8_t stopbits, uint8_t parity)
+{
+  const uint8_t idx = baudrate % LENGTH(baudrates);
+  UBRRL = baudrates[idx][1];
+  UBRRH = baudrates[idx][0];
+  UCSRA &= ~_BV(U2X);
+
+  // UART Receiver (mit Interrupt) und Transmitter anschalten
+  UCSRB = _BV(RXCIE) | _BV(RXEN) | _BV(TXEN);
+
+  uint8_t ucsrc = _BV(URSEL);
+  switch (stopbits)
+  {
+    default:
+      break;
+
+    case 2:
+      ucsrc |= _BV(USBS);
+      break;
+  };
+  switch (databits)
+  {
+    default:
+      ucsrc |= _BV(UCSZ1) | _BV(UCSZ0);
+      break;
+
+    case 7:
+      ucsrc |= _BV(UCSZ1);
+      break;
+  };
+  switch (parity)
+  {
+    default:
+      break;
+
+    case even:
+      ucsrc |= _BV(UPM1);
+      break;
+
+    case odd:
+      ucsrc |= _BV(UPM0) | _BV(UPM1);
+      break;
+  };
+  UCSRC = ucsrc;
+
+  // Flush Receive-Buffer
+  do
+  {
+    UDR;
+  }
+  while (UCSRA & _BV(RXC));
+}
+
+
+/*********
+ * Reset *
+ *********/
+
+void hal_reset (void)
+{
+  wdt_enable (WDTO_15MS);
+  cli ();
+}
+
+
+uint8_t mcusr_mirror __attribute__ ((section (".noinit")));
+
+
+void get_mcusr(void) \
+  __attribute__((naked)) \
+  __attribute__((section(".init3")));
+
+void get_mcusr(void)
+{
+  mcusr_mirror = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+
+/************
+ * Speicher *
+ ************/
+
+/* aus dem Linkerskript von avr-libc */
+extern uint8_t __data_start, __data_end, __bss_start, __bss_end;
+extern uint8_t __noinit_start, __noinit_end, __heap_start;
+
+#define HAL_MEM_PAINT   0xC5
+
+
+/* bemalt den freien Bereich bis zum Stackzeiger, vor .data/.bss-Initialisierung */
+void hal_mem_paint (void) \
+  __attribute__((naked)) \
+  __attribute__((section(".init3")));
+
+void hal_mem_paint (void)
+{
+  for (uint8_t *p = &__heap_start; p <= (uint8_t *) SP; ++p)
+  {
+    *p = HAL_MEM_PAINT;
+  }
+}
+
+
+void hal_mem (struct HalMem *m)
+{
+  const uint8_t *p = &__heap_start;
+
+  while (p < (const uint8_t *) SP && *p == HAL_MEM_PAINT)
+  {
+    ++p;
+  };
+  m->data   = &__data_end - &__data_start;
+  m->bss    = &__bss_end - &__bss_start;
+  m->noinit = &__noinit_end - &__noinit_start;
+  m->free   = RAMEND + 1 - (uint16_t) &__heap_start;
+  m->unused = p - &__heap_start;
+  m->stack  = RAMEND - SP;
+}
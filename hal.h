@@ -0,0 +1,394 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _HAL_H
+#define _HAL_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Hardware-Abstraktion fuer Signal-Pin, Timer, UART, DIP-Switches,
+ * PDN, Sleep und Reset.  Auf dem ATmega32 inline auf die Register,
+ * mit HOST als Simulation in host/hal.c.
+ */
+
+
+extern void hal_init (void);
+extern void hal_timer_init (void);
+extern void hal_capture_init (void);
+extern void hal_sample_init (void);
+extern void hal_pps_init (void);
+extern void hal_power_init (void);
+extern void hal_uart_init (uint8_t baudrate, uint8_t databits, uint8_t stopbits, uint8_t parity);
+extern void hal_reset (void);
+
+
+/* SRAM: .data, .bss, .noinit, dahinter frei bis zum Stack (RAMEND) */
+struct HalMem
+{
+  uint16_t data, bss, noinit;
+  uint16_t free;                /* zwischen .noinit und RAMEND */
+  uint16_t unused;              /* davon seit Reset nie beschrieben */
+  uint16_t stack;               /* jetzt belegt */
+};
+
+extern void hal_mem (struct HalMem *m);
+
+
+#ifndef HOST
+
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "defs.h"
+
+
+#define HAL_UART_RXC    _BV(RXC)
+#define HAL_UART_TXC    _BV(TXC)
+#define HAL_UART_UDRE   _BV(UDRE)
+#define HAL_UART_FE     _BV(FE)
+#define HAL_UART_DOR    _BV(DOR)
+#define HAL_UART_PE     _BV(PE)
+
+
+/* DCF77-Signal an PD2, die Flanken kommen ueber ICP1/PD6 */
+static inline bool hal_signal_state (void)
+{
+  return !!(PIND & _BV(PD2));
+}
+
+
+static inline uint8_t hal_get_tcnt0 (void)
+{
+  return TCNT0;
+}
+
+
+static inline void hal_set_tcnt0 (uint8_t v)
+{
+  TCNT0 = v;
+}
+
+
+/* CTC: Periode OCR0+1, nur direkt nach dem Compare-Interrupt aendern */
+static inline void hal_set_ocr0 (uint8_t v)
+{
+  OCR0 = v;
+}
+
+
+static inline uint16_t hal_get_tcnt1 (void)
+{
+  return TCNT1;
+}
+
+
+static inline uint16_t hal_get_icr1 (void)
+{
+  return ICR1;
+}
+
+
+/* Ueberlauf von Timer 1, dessen Interrupt noch aussteht */
+static inline bool hal_t1_overflow (void)
+{
+  return !!(TIFR & _BV(TOV1));
+}
+
+
+static inline void hal_set_ocr1a (uint16_t v)
+{
+  OCR1A = v;
+}
+
+
+/* TIMSK nur bei gesperrten Interrupts aendern, ein anstehender Match bleibt */
+static inline void hal_ocie1a (bool on)
+{
+  if (on)
+  {
+    TIMSK |=  _BV(OCIE1A);
+  }
+  else
+  {
+    TIMSK &= ~_BV(OCIE1A);
+  }
+}
+
+
+static inline void hal_clear_ocf1a (void)
+{
+  TIFR = _BV(OCF1A);
+}
+
+
+static inline void hal_ocie1b (bool on)
+{
+  if (on)
+  {
+    TIMSK |=  _BV(OCIE1B);
+  }
+  else
+  {
+    TIMSK &= ~_BV(OCIE1B);
+  }
+}
+
+
+static inline void hal_clear_ocf1b (void)
+{
+  TIFR = _BV(OCF1B);
+}
+
+
+extern uint8_t hal_t2_phase;
+
+
+/* Timer 2 mit Interrupt ab jetzt starten oder ganz anhalten, nur bei gesperrten Interrupts */
+static inline void hal_sample_run (bool on)
+{
+  if (on)
+  {
+    SFIOR |=  _BV(PSR2);
+    hal_t2_phase = TCNT1;
+    TCNT2  =  0;
+    TCCR2  =  _BV(WGM21) | _BV(CS22);
+    TIFR   =  _BV(OCF2);
+    TIMSK |=  _BV(OCIE2);
+  }
+  else
+  {
+    TIMSK &= ~_BV(OCIE2);
+    TCCR2  =  _BV(WGM21);
+  }
+}
+
+
+/* INT0 an PD2 bei jedem Pegelwechsel, nur bei gesperrten Interrupts */
+static inline void hal_int0 (bool on)
+{
+  if (on)
+  {
+    MCUCR  = (MCUCR & ~(_BV(ISC01) | _BV(ISC00))) | _BV(ISC00);
+    GIFR   =  _BV(INTF0);
+    GICR  |=  _BV(INT0);
+  }
+  else
+  {
+    GICR  &= ~_BV(INT0);
+  }
+}
+
+
+static inline void hal_set_ocr1b (uint16_t v)
+{
+  OCR1B = v;
+}
+
+
+/* OC1B/PD4 beim naechsten Compare-Match setzen (true) oder loeschen */
+static inline void hal_pps_set_on_match (bool set)
+{
+  if (set)
+  {
+    TCCR1A |=  _BV(COM1B0);
+  }
+  else
+  {
+    TCCR1A &= ~_BV(COM1B0);
+  }
+}
+
+
+/*
+ * Taktzaehler fuer Messungen bei gesperrten Interrupts, auf
+ * TIMER1PRESCALE Takte genau.  Bis 65535 Takte.  In ISRs ueber
+ * timer1_isr_start() (timer1.c).
+ */
+static inline uint16_t hal_cycles_start (void)
+{
+  return TCNT1;
+}
+
+
+static inline uint16_t hal_cycles_stop (uint16_t tcnt1)
+{
+  const uint32_t cycles = (uint32_t) (uint16_t) (TCNT1 - tcnt1) * TIMER1PRESCALE;
+  return cycles > UINT16_MAX ? UINT16_MAX : cycles;
+}
+
+
+static inline uint16_t hal_ticks_to_cycles (uint32_t ticks)
+{
+  const uint32_t cycles = ticks * TIMER1PRESCALE;
+  return cycles > UINT16_MAX ? UINT16_MAX : cycles;
+}
+
+
+/*
+ * Takte vom ausloesenden Ereignis bis jetzt, am Anfang der ISR, auf
+ * TIMER1PRESCALE Takte genau.  Timer 0 teilt den Vorteiler mit Timer 1
+ * und zaehlt bei TCNT1 % T1_PER_T0 == 0 (hal_timer_init()), Timer 2
+ * bei TCNT1 % 8 == hal_t2_phase % 8 (hal_sample_run()).  Im CTC-Modus
+ * zaehlen TCNT0 und TCNT2 ab dem Match von 0.
+ */
+static inline uint16_t hal_latency_t0 (void)
+{
+  const uint8_t tcnt0 = TCNT0;
+  const uint16_t tcnt1 = TCNT1;
+  return hal_ticks_to_cycles ((uint32_t) tcnt0 * (TIMER0PRESCALE / TIMER1PRESCALE)
+                              + tcnt1 % (TIMER0PRESCALE / TIMER1PRESCALE));
+}
+
+
+static inline uint16_t hal_latency_t2 (void)
+{
+  const uint8_t tcnt2 = TCNT2;
+  const uint16_t tcnt1 = TCNT1;
+  return hal_ticks_to_cycles ((uint16_t) tcnt2 * (64 / TIMER1PRESCALE)
+                              + (uint8_t) (tcnt1 - hal_t2_phase) % (64 / TIMER1PRESCALE));
+}
+
+
+static inline uint16_t hal_latency_capt (void)
+{
+  return hal_ticks_to_cycles ((uint16_t) (TCNT1 - ICR1));
+}
+
+
+static inline uint16_t hal_latency_compa (void)
+{
+  return hal_ticks_to_cycles ((uint16_t) (TCNT1 - OCR1A));
+}
+
+
+static inline uint16_t hal_latency_compb (void)
+{
+  return hal_ticks_to_cycles ((uint16_t) (TCNT1 - OCR1B));
+}
+
+
+static inline uint16_t hal_latency_ovf (void)
+{
+  return hal_ticks_to_cycles (TCNT1);
+}
+
+
+static inline uint8_t hal_switches (void)
+{
+  return (PIN_SWITCHES & MASK_SWITCHES) ^ MASK_SWITCHES;
+}
+
+
+static inline void hal_pdn (bool on)
+{
+  if (on)
+  {
+    PORT_PDN |=  MASK_PDN;
+  }
+  else
+  {
+    PORT_PDN &= ~MASK_PDN;
+  }
+}
+
+
+static inline uint8_t hal_uart_status (void)
+{
+  return UCSRA;
+}
+
+
+static inline uint8_t hal_uart_getc (void)
+{
+  return UDR;
+}
+
+
+/* loescht TXC, damit uart_drain() das Ende der Uebertragung erkennt */
+static inline void hal_uart_putc (uint8_t c)
+{
+  UCSRA = (UCSRA & (_BV(U2X) | _BV(MPCM))) | _BV(TXC);
+  UDR = c;
+}
+
+
+static inline void hal_uart_udrie (bool on)
+{
+  if (on)
+  {
+    UCSRB |=  _BV(UDRIE);
+  }
+  else
+  {
+    UCSRB &= ~_BV(UDRIE);
+  }
+}
+
+
+static inline void hal_sleep (void)
+{
+  cli ();
+  set_sleep_mode (SLEEP_MODE_IDLE);
+  sleep_enable ();
+  sei ();
+  sleep_cpu ();
+  sleep_disable ();
+}
+
+
+#else
+
+
+#define HAL_UART_RXC    0b10000000
+#define HAL_UART_TXC    0b01000000
+#define HAL_UART_UDRE   0b00100000
+#define HAL_UART_FE     0b00010000
+#define HAL_UART_DOR    0b00001000
+#define HAL_UART_PE     0b00000100
+
+
+extern bool hal_signal_state (void);
+extern uint8_t hal_get_tcnt0 (void);
+extern void hal_set_tcnt0 (uint8_t v);
+extern void hal_set_ocr0 (uint8_t v);
+extern uint16_t hal_get_tcnt1 (void);
+extern uint16_t hal_get_icr1 (void);
+extern bool hal_t1_overflow (void);
+extern void hal_set_ocr1a (uint16_t v);
+extern void hal_ocie1a (bool on);
+extern void hal_clear_ocf1a (void);
+extern void hal_ocie1b (bool on);
+extern void hal_clear_ocf1b (void);
+extern void hal_sample_run (bool on);
+extern void hal_int0 (bool on);
+extern void hal_set_ocr1b (uint16_t v);
+extern void hal_pps_set_on_match (bool set);
+extern uint16_t hal_cycles_start (void);
+extern uint16_t hal_cycles_stop (uint16_t tcnt1);
+extern uint16_t hal_latency_t0 (void);
+extern uint16_t hal_latency_t2 (void);
+extern uint16_t hal_latency_capt (void);
+extern uint16_t hal_latency_compa (void);
+extern uint16_t hal_latency_compb (void);
+extern uint16_t hal_latency_ovf (void);
+extern uint8_t hal_switches (void);
+extern void hal_pdn (bool on);
+extern uint8_t hal_uart_status (void);
+extern uint8_t hal_uart_getc (void);
+extern void hal_uart_putc (uint8_t c);
+extern void hal_uart_udrie (bool on);
+extern void hal_sleep (void);
+
+
+#endif
+
+
+#endif
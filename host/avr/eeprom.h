@@ -0,0 +1,41 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _HOST_AVR_EEPROM_H
+#define _HOST_AVR_EEPROM_H
+
+
+#include <stdint.h>
+
+
+/* EEPROM als gewoehnlicher Speicher, nicht persistent */
+#define EEMEM
+
+
+static inline uint8_t eeprom_read_byte (const uint8_t *p)
+{
+  return *p;
+}
+
+
+static inline void eeprom_update_byte (uint8_t *p, uint8_t v)
+{
+  *p = v;
+}
+
+
+static inline uint32_t eeprom_read_dword (const uint32_t *p)
+{
+  return *p;
+}
+
+
+static inline void eeprom_update_dword (uint32_t *p, uint32_t v)
+{
+  *p = v;
+}
+
+
+#endif
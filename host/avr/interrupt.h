@@ -0,0 +1,17 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _HOST_AVR_INTERRUPT_H
+#define _HOST_AVR_INTERRUPT_H
+
+
+/* Interruptvektoren sind gewoehnliche Funktionen, host/hal.c ruft sie auf */
+#define ISR(vector, ...)        void vector (void); void vector (void)
+
+#define cli()
+#define sei()
+
+
+#endif
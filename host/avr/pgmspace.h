@@ -0,0 +1,20 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _HOST_AVR_PGMSPACE_H
+#define _HOST_AVR_PGMSPACE_H
+
+
+#include <stdio.h>
+#include <string.h>
+
+
+#define PSTR(s)                 (s)
+#define strcmp_P                strcmp
+#define snprintf_P              snprintf
+#define vsnprintf_P             vsnprintf
+
+
+#endif
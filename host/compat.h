@@ -0,0 +1,33 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _COMPAT_H
+#define _COMPAT_H
+
+
+/* avr-gcc/avr-libc-Eigenheiten fuer den nativen Build (-include) */
+
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+
+#define __flash
+
+
+extern size_t strlcpy (char *dst, const char *src, size_t size);
+
+
+/* avr-libc-Streams, nur Ausgabe; die put-Funktion merkt sich host/hal.c */
+#define _FDEV_SETUP_WRITE               2
+#define fdev_setup_stream(s, p, g, f)   host_fdev_setup_stream (s, p)
+#define vfprintf_P                      host_vfprintf
+
+extern void host_fdev_setup_stream (FILE *stream, int (*put) (char c, FILE *stream));
+extern int host_vfprintf (FILE *stream, const char *fmt, va_list ap);
+
+
+#endif
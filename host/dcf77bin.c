@@ -0,0 +1,113 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "telegram.h"
+
+
+/*
+ * Liest das Binaertelegramm (FORMAT_BINARY) aus einer Datei oder von
+ * stdin, etwa von der seriellen Schnittstelle (8N1), synchronisiert
+ * sich auf TG_SYNC0/TG_SYNC1, prueft die CRC und gibt je Telegramm
+ * eine Zeile aus:
+ *
+ *   <UTC ISO 8601> <Status QCTL/-> holdover=<min> quality=<0..100>
+ *
+ * Telegramme mit falscher CRC werden gezaehlt und verworfen.
+ */
+
+
+static uint32_t get_le (const uint8_t *p, uint8_t n)
+{
+  uint32_t v = 0;
+
+  while (n--)
+  {
+    v = v << 8 | p[n];
+  };
+  return v;
+}
+
+
+static void print_frame (const uint8_t *f)
+{
+  const time_t t = get_le (f + TG_EPOCH, 4);
+  const uint8_t status = f[TG_STATUS];
+  struct tm tm;
+  char iso[32];
+
+  gmtime_r (&t, &tm);
+  strftime (iso, sizeof iso, "%Y-%m-%dT%H:%M:%SZ", &tm);
+  printf ("%s %c%c%c%c holdover=%" PRIu32 " quality=%u\n",
+          iso,
+          status & TG_QUARTZ    ? 'Q' : '-',
+          status & TG_CEST      ? 'C' : '-',
+          status & TG_TZ_CHANGE ? 'T' : '-',
+          status & TG_LEAP      ? 'L' : '-',
+          get_le (f + TG_HOLDOVER, 2), f[TG_QUALITY]);
+  fflush (stdout);
+}
+
+
+int main (int argc, char **argv)
+{
+  FILE *in = argc > 1 ? fopen (argv[1], "rb") : stdin;
+  uint8_t f[TG_LEN];
+  unsigned n = 0;
+  unsigned long crc_errors = 0;
+  int c;
+
+  if (argc > 2)
+  {
+    fprintf (stderr, "usage: dcf77bin [telegrams]\n");
+    return EXIT_FAILURE;
+  };
+  if (!in)
+  {
+    perror (argv[1]);
+    return EXIT_FAILURE;
+  };
+
+  while ((c = getc (in)) != EOF)
+  {
+    f[n++] = c;
+
+    /* Synchronisation */
+    if ((n == 1 && f[0] != TG_SYNC0) || (n == 2 && f[1] != TG_SYNC1))
+    {
+      n = f[n-1] == TG_SYNC0;
+      f[0] = TG_SYNC0;
+      continue;
+    };
+    if (n < TG_LEN)
+    {
+      continue;
+    };
+    n = 0;
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = TG_EPOCH; i < TG_CRC; ++i)
+    {
+      crc = telegram_crc16 (crc, f[i]);
+    };
+    if (crc != get_le (f + TG_CRC, 2))
+    {
+      ++crc_errors;
+      continue;
+    };
+    print_frame (f);
+  };
+
+  if (crc_errors)
+  {
+    fprintf (stderr, "dcf77bin: %lu CRC errors\n", crc_errors);
+  };
+  return EXIT_SUCCESS;
+}
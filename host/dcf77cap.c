@@ -0,0 +1,209 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "telegram.h"
+#include "capture.h"
+
+
+/*
+ * Liest die Ausgabe des Kommandos capture aus einer Datei, von stdin
+ * oder einer seriellen Schnittstelle, prueft Synchronisation und CRC
+ * und schreibt die Flanken als Signal fuer host/dcf77sim:
+ *
+ *   dcf77cap /dev/ttyUSB0 > signal      (vorher stty raw 9600)
+ *   dcf77cap -w roh.bin /dev/ttyUSB0 | dcf77sim
+ *
+ * Die Zeiten bleiben Timer-1-Takte seit Reset und werden so gerundet,
+ * dass die Simulation jede Flanke im selben Takt sieht.  Mit -w
+ * wandert der Rohstrom zusaetzlich in eine Datei.
+ */
+
+
+/* groesster Block: Kopf, LEB128 mit hoechstens 5 Byte je Flanke, CRC */
+#define CAP_MAX         (CAP_HEAD + (CAPTURE_LEN - 1) * 5 + 2)
+
+
+static uint32_t get_le (const uint8_t *p, uint8_t n)
+{
+  uint32_t v = 0;
+
+  while (n--)
+  {
+    v = v << 8 | p[n];
+  };
+  return v;
+}
+
+
+/*
+ * Laenge des Blocks am Anfang von f, 0 = noch unvollstaendig,
+ * -1 = kein Block, Synchronisation verloren
+ */
+static int block_len (const uint8_t *f, unsigned n)
+{
+  if ((n > 0 && f[0] != CAP_SYNC0) || (n > 1 && f[1] != CAP_SYNC1) || (n > 2 && f[2] >= CAPTURE_LEN))
+  {
+    return -1;
+  };
+  if (n < CAP_HEAD)
+  {
+    return 0;
+  };
+
+  unsigned i = CAP_HEAD;
+  for (unsigned e = 0; e < f[2]; ++e)
+  {
+    for (unsigned b = 0; ; ++b, ++i)
+    {
+      if (b == 5)
+      {
+        return -1;
+      };
+      if (i >= n)
+      {
+        return 0;
+      };
+      if (!(f[i] & 0x80))
+      {
+        ++i;
+        break;
+      }
+    }
+  };
+  if (i + 2 > n)
+  {
+    return 0;
+  };
+
+  uint16_t crc = 0xFFFF;
+  for (unsigned k = 2; k < i; ++k)
+  {
+    crc = telegram_crc16 (crc, f[k]);
+  };
+  return crc == get_le (f + i, 2) ? (int) i + 2 : -1;
+}
+
+
+/* Timer-1-Takt auf µs, die Simulation rundet den Takt wieder ab */
+static uint64_t tick_to_us (uint64_t t)
+{
+  return (t * TIMER1PRESCALE * 1000000 + F_CPU - 1) / F_CPU;
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "usage: dcf77cap [-w raw] [capture]\n");
+  exit (EXIT_FAILURE);
+}
+
+
+int main (int argc, char **argv)
+{
+  FILE *raw = NULL;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "w:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w':
+        raw = fopen (optarg, "wb");
+        if (!raw)
+        {
+          perror (optarg);
+          return EXIT_FAILURE;
+        };
+        break;
+
+      default:
+        usage ();
+    }
+  };
+  if (optind < argc - 1)
+  {
+    usage ();
+  };
+
+  FILE *in = optind < argc ? fopen (argv[optind], "rb") : stdin;
+  if (!in)
+  {
+    perror (argv[optind]);
+    return EXIT_FAILURE;
+  };
+
+  uint8_t f[CAP_MAX];
+  unsigned n = 0;
+  unsigned long blocks = 0, edges = 0, lost = 0, skipped = 0;
+  uint64_t t = 0;
+  bool level = false;
+  int c;
+
+  while ((c = getc (in)) != EOF)
+  {
+    if (raw)
+    {
+      putc (c, raw);
+    };
+    f[n++] = c;
+
+    int len;
+    while (n > 0 && (len = block_len (f, n)) != 0)
+    {
+      if (len < 0)
+      {
+        /* ein Byte weiter neu aufsetzen */
+        memmove (f, f + 1, --n);
+        ++skipped;
+        continue;
+      };
+
+      /* 32-Bit-Zeit relativ zum vorigen Block fortsetzen */
+      const uint32_t first = get_le (f + 4, 4);
+      t = blocks++ ? t + (int32_t) (first - (uint32_t) t) : first;
+      lost += f[3];
+
+      unsigned i = CAP_HEAD;
+      for (unsigned e = 0; e < f[2]; ++e)
+      {
+        uint32_t v = 0;
+        for (unsigned s = 0; ; s += 7)
+        {
+          v |= (uint32_t) (f[i] & 0x7F) << s;
+          if (!(f[i++] & 0x80))
+          {
+            break;
+          }
+        };
+        if (edges++ == 0)
+        {
+          printf ("0 %u\n", !(v & 1));
+        }
+        else if ((v & 1) == level)
+        {
+          /* verlorene Flanken: Gegenpegel einen Takt vorher einfuegen */
+          printf ("%" PRIu64 " %u\n", tick_to_us (t + (v >> 1) - 1), !level);
+        };
+        t += v >> 1;
+        level = v & 1;
+        printf ("%" PRIu64 " %u\n", tick_to_us (t), level);
+      };
+      fflush (stdout);
+
+      memmove (f, f + len, n - len);
+      n -= len;
+    }
+  };
+
+  fprintf (stderr, "dcf77cap: %lu blocks, %lu edges, %lu lost, %lu bytes skipped\n", blocks, edges, lost, skipped);
+  return EXIT_SUCCESS;
+}
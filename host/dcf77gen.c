@@ -0,0 +1,591 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/*
+ * Erzeugt das DCF77-Signal am Empfaengerausgang fuer einen UTC-Bereich
+ * als "<µs> <0|1>" fuer host/dcf77sim (0 = Absenkung):
+ *
+ *   dcf77gen -t "2016-12-31 22:30" -n 120 -L 2016-12-31 | dcf77sim
+ *
+ * Der Rahmen der Minute ab S traegt die Zeit bei S + 1 min, MEZ/MESZ
+ * nach den EU-Regeln (letzter Sonntag im Maerz/Oktober, 01:00 UTC).
+ * A1 (Bit 16) steht in der Stunde vor der Umstellung, A2 (Bit 19) in
+ * der Stunde vor einer Schaltsekunde; die Minute davor hat dann 61
+ * Sekunden, Sekunde 59 eine 0, Sekunde 60 keine Absenkung.  Die
+ * Wetterbits 1..14 sind zufaellig.
+ *
+ * Stoerungen: Flanken- und Pulsbreitenjitter, Verzoegerung des
+ * Empfaengers fuer Beginn und Ende der Absenkung, fehlende Pulse,
+ * Stoerimpulse (Poisson), Schwund (zufaellige Phasen mit halb
+ * fehlenden Pulsen und vielen Stoerimpulsen) und Ausfaelle ganzer
+ * Minuten.  Alle Flanken laufen als Umschaltungen durch einen kleinen
+ * sortierten Puffer, damit sich Stoerimpulse und Pulse beliebig
+ * ueberlagern duerfen.
+ */
+
+
+#define MAX_LIST        16
+
+/* Jitter wird hierauf begrenzt, der Puffer haelt so viel Vorlauf */
+#define JITTER_MAX      300000
+
+/* Schwund: jeder zweite Puls fehlt, Stoerimpulse je Sekunde */
+#define FADE_MISSING    0.5
+#define FADE_GLITCHES   5
+
+#define TOGGLES         256
+
+
+struct Options
+{
+  int64_t start, end;                   /* UTC, Minutenanfang */
+  int64_t leap[MAX_LIST];               /* Minuten mit Schaltsekunde */
+  int64_t drop[MAX_LIST][2];            /* Ausfall ab, bis (UTC) */
+  unsigned leaps, drops;
+  double jitter, width_jitter;          /* µs Standardabweichung */
+  double delay_start, delay_end;        /* µs */
+  double missing;                       /* Wahrscheinlichkeit je Sekunde */
+  double glitches;                      /* je Sekunde */
+  double glitch_len;                    /* µs, hoechstens */
+  double fades, fade_len;               /* je Stunde, mittlere Dauer s */
+  double ppm;
+  uint64_t offset;                      /* µs bis Sekunde 0 */
+  uint64_t seed;
+};
+
+
+/************
+ * Kalender *
+ ************/
+
+/* Tage seit 1970-01-01 (proleptisch gregorianisch) */
+static int64_t days_from_civil (int y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = y - era * 400;
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+
+static void civil_from_days (int64_t z, int *y, unsigned *m, unsigned *d)
+{
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = z - era * 146097;
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+
+/* 1 = Montag .. 7 = Sonntag */
+static unsigned iso_wday (int64_t days)
+{
+  return (days % 7 + 7 + 3) % 7 + 1;
+}
+
+
+static int64_t last_sunday (int y, unsigned m)
+{
+  const int64_t last = days_from_civil (m == 12 ? y + 1 : y, m == 12 ? 1 : m + 1, 1) - 1;
+  return last - iso_wday (last) % 7;
+}
+
+
+static int64_t floor_div (int64_t a, int64_t b)
+{
+  return a / b - (a % b < 0);
+}
+
+
+/* UTC-Sekunde t liegt in der MESZ */
+static bool is_cest (int64_t t)
+{
+  int y;
+  unsigned m, d;
+
+  civil_from_days (floor_div (t, 86400), &y, &m, &d);
+  return last_sunday (y, 3) * 86400 + 3600 <= t && t < last_sunday (y, 10) * 86400 + 3600;
+}
+
+
+/* "YYYY-MM-DD[ HH:MM]" in UTC-Sekunden */
+static bool parse_time (const char *s, int64_t *t)
+{
+  int y;
+  unsigned m, d, hh = 0, mm = 0;
+
+  if (sscanf (s, "%d-%u-%u %u:%u", &y, &m, &d, &hh, &mm) < 3
+      ||
+      m < 1 || m > 12 || d < 1 || d > 31 || hh > 23 || mm > 59)
+  {
+    return false;
+  };
+  *t = days_from_civil (y, m, d) * 86400 + hh * 3600 + mm * 60;
+  return true;
+}
+
+
+/**********
+ * Rahmen *
+ **********/
+
+struct Minute
+{
+  uint8_t bits[61];
+  uint8_t len;                          /* 60 oder 61 Sekunden */
+};
+
+
+static bool leap_minute (const struct Options *o, int64_t s)
+{
+  for (unsigned i = 0; i < o->leaps; ++i)
+  {
+    if (o->leap[i] == s)
+    {
+      return true;
+    }
+  };
+  return false;
+}
+
+
+static bool leap_announced (const struct Options *o, int64_t s)
+{
+  for (unsigned i = 0; i < o->leaps; ++i)
+  {
+    if (o->leap[i] - 59 * 60 <= s && s <= o->leap[i])
+    {
+      return true;
+    }
+  };
+  return false;
+}
+
+
+static unsigned put_bcd (uint8_t *b, unsigned v, unsigned n)
+{
+  unsigned parity = 0;
+
+  v = v / 10 << 4 | v % 10;
+  for (unsigned i = 0; i < n; ++i)
+  {
+    b[i] = v >> i & 1;
+    parity ^= b[i];
+  };
+  return parity;
+}
+
+
+static uint64_t rng_state;
+
+
+/* xorshift64* */
+static uint64_t rng (void)
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+
+/* gleichverteilt in [0, 1) */
+static double uniform (void)
+{
+  return (rng () >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+static double gauss (double sigma)
+{
+  if (sigma == 0)
+  {
+    return 0;
+  };
+  const double g = sqrt (-2 * log (1 - uniform ())) * cos (2 * M_PI * uniform ()) * sigma;
+  return g < -JITTER_MAX ? -JITTER_MAX : g > JITTER_MAX ? JITTER_MAX : g;
+}
+
+
+static double exponential (double mean)
+{
+  return -log (1 - uniform ()) * mean;
+}
+
+
+/* Minute ab UTC s, traegt die Zeit bei s + 60 */
+static void make_minute (const struct Options *o, int64_t s, struct Minute *f)
+{
+  const int64_t t = s + 60;
+  const bool cest = is_cest (t);
+  const int64_t local = t + (cest ? 7200 : 3600);
+  const int64_t days = floor_div (local, 86400);
+  const unsigned sod = local - days * 86400;
+  int y;
+  unsigned m, d;
+  uint8_t *const b = f->bits;
+
+  civil_from_days (days, &y, &m, &d);
+  memset (f->bits, 0, sizeof f->bits);
+  f->len = leap_minute (o, s) ? 61 : 60;
+
+  for (unsigned i = 1; i <= 14; ++i)
+  {
+    b[i] = rng () >> 63;
+  };
+  b[16] = is_cest (s) != is_cest (s + 3600);
+  b[17] = cest;
+  b[18] = !cest;
+  b[19] = leap_announced (o, s);
+  b[20] = 1;
+  b[28] = put_bcd (b + 21, sod / 60 % 60, 7);
+  b[35] = put_bcd (b + 29, sod / 3600, 6);
+  b[58] = put_bcd (b + 36, d, 6)
+          ^ put_bcd (b + 42, iso_wday (days), 3)
+          ^ put_bcd (b + 45, m, 5)
+          ^ put_bcd (b + 50, (y % 100 + 100) % 100, 8);
+  /* Schaltsekunde: Sekunde 59 traegt eine 0, Sekunde 60 bleibt leer */
+  b[59] = 0;
+}
+
+
+/***********
+ * Ausgabe *
+ ***********/
+
+static uint64_t toggles[TOGGLES];
+static unsigned ntoggles;
+static bool level = 1;
+static uint64_t last_out;
+
+static char obuf[1 << 16];
+static unsigned olen;
+
+
+static void out_flush (void)
+{
+  fwrite (obuf, 1, olen, stdout);
+  olen = 0;
+}
+
+
+static void out_edge (uint64_t us, bool l)
+{
+  char tmp[24];
+  unsigned n = 0;
+
+  if (olen > sizeof obuf - 32)
+  {
+    out_flush ();
+  };
+  do
+  {
+    tmp[n++] = '0' + us % 10;
+    us /= 10;
+  }
+  while (us);
+  while (n)
+  {
+    obuf[olen++] = tmp[--n];
+  };
+  obuf[olen++] = ' ';
+  obuf[olen++] = '0' + l;
+  obuf[olen++] = '\n';
+}
+
+
+/* Umschaltung einsortieren, von hinten, die meisten kommen in Reihenfolge */
+static void toggle (uint64_t us)
+{
+  if (ntoggles == TOGGLES)
+  {
+    fprintf (stderr, "dcf77gen: too many edges in %u µs\n", JITTER_MAX);
+    exit (EXIT_FAILURE);
+  };
+
+  unsigned i = ntoggles++;
+  while (i > 0 && toggles[i-1] > us)
+  {
+    toggles[i] = toggles[i-1];
+    --i;
+  };
+  toggles[i] = us;
+}
+
+
+/* alle Umschaltungen vor until ausgeben, gleichzeitige heben sich auf */
+static void emit_until (uint64_t until)
+{
+  unsigned i = 0;
+
+  while (i < ntoggles && toggles[i] < until)
+  {
+    if (i + 1 < ntoggles && toggles[i+1] == toggles[i])
+    {
+      i += 2;
+      continue;
+    };
+    level = !level;
+    last_out = toggles[i] < last_out ? last_out : toggles[i];
+    out_edge (last_out, level);
+    ++i;
+  };
+  memmove (toggles, toggles + i, (ntoggles - i) * sizeof toggles[0]);
+  ntoggles -= i;
+}
+
+
+/*****************
+ * Hauptprogramm *
+ *****************/
+
+static void usage (void)
+{
+  fprintf (stderr,
+           "usage: dcf77gen [-t start] [-e end | -n minutes] [-L day]... [-o min,len]...\n"
+           "                [-j µs] [-w µs] [-d µs[,µs]] [-m prob] [-g rate[,µs]]\n"
+           "                [-f per_hour[,s]] [-p ppm] [-O µs] [-s seed]\n");
+  exit (EXIT_FAILURE);
+}
+
+
+int main (int argc, char **argv)
+{
+  struct Options o =
+  {
+    .glitch_len = 20000,
+    .fade_len = 60,
+    .offset = 300000,
+    .seed = 1,
+  };
+  int64_t minutes = 10;
+  bool have_end = false;
+  int opt;
+
+  parse_time ("2022-06-18 10:00", &o.start);
+
+  while ((opt = getopt (argc, argv, "t:e:n:L:o:j:w:d:m:g:f:p:O:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 't':
+        if (!parse_time (optarg, &o.start))
+        {
+          usage ();
+        };
+        break;
+
+      case 'e':
+        if (!parse_time (optarg, &o.end))
+        {
+          usage ();
+        };
+        have_end = true;
+        break;
+
+      case 'n':
+        minutes = strtoll (optarg, NULL, 0);
+        break;
+
+      case 'L':
+        {
+          int64_t day;
+
+          if (o.leaps == MAX_LIST || !parse_time (optarg, &day))
+          {
+            usage ();
+          };
+          /* am Ende des UTC-Tages, nach 23:59:59 */
+          o.leap[o.leaps++] = floor_div (day, 86400) * 86400 + 86400 - 60;
+        };
+        break;
+
+      case 'o':
+        {
+          long long from, len;
+
+          if (o.drops == MAX_LIST || sscanf (optarg, "%lld,%lld", &from, &len) != 2)
+          {
+            usage ();
+          };
+          o.drop[o.drops][0] = from;
+          o.drop[o.drops][1] = from + len;
+          ++o.drops;
+        };
+        break;
+
+      case 'j':
+        o.jitter = strtod (optarg, NULL);
+        break;
+
+      case 'w':
+        o.width_jitter = strtod (optarg, NULL);
+        break;
+
+      case 'd':
+        if (sscanf (optarg, "%lf,%lf", &o.delay_start, &o.delay_end) == 1)
+        {
+          o.delay_end = o.delay_start;
+        };
+        break;
+
+      case 'm':
+        o.missing = strtod (optarg, NULL);
+        break;
+
+      case 'g':
+        sscanf (optarg, "%lf,%lf", &o.glitches, &o.glitch_len);
+        break;
+
+      case 'f':
+        sscanf (optarg, "%lf,%lf", &o.fades, &o.fade_len);
+        break;
+
+      case 'p':
+        o.ppm = strtod (optarg, NULL);
+        break;
+
+      case 'O':
+        o.offset = strtoull (optarg, NULL, 0);
+        break;
+
+      case 's':
+        o.seed = strtoull (optarg, NULL, 0);
+        break;
+
+      default:
+        usage ();
+    }
+  };
+  if (optind != argc)
+  {
+    usage ();
+  };
+  if (!have_end)
+  {
+    o.end = o.start + minutes * 60;
+  };
+  if (o.offset < JITTER_MAX + fabs (o.delay_start))
+  {
+    o.offset = JITTER_MAX + fabs (o.delay_start);
+  };
+
+  rng_state = o.seed * 0x9E3779B97F4A7C15ULL | 1;
+
+  /* Ausfaelle in Minuten ab Start nach UTC */
+  for (unsigned i = 0; i < o.drops; ++i)
+  {
+    o.drop[i][0] = o.start + o.drop[i][0] * 60;
+    o.drop[i][1] = o.start + o.drop[i][1] * 60;
+  };
+
+  const double scale = 1 + o.ppm * 1e-6;
+  unsigned long secs = 0, pulses = 0, missing = 0, glitches = 0, fade_secs = 0;
+  uint64_t k = 0;                               /* Sekunden seit Start */
+  double next_glitch = o.glitches > 0 ? exponential (1e6 / o.glitches) : INFINITY;
+  double fade_start = o.fades > 0 ? exponential (3600e6 / o.fades) : INFINITY, fade_end = 0;
+
+  printf ("# dcf77gen");
+  for (int i = 1; i < argc; ++i)
+  {
+    printf (" %s", argv[i]);
+  };
+  printf ("\n0 1\n");
+
+  for (int64_t s = o.start; s < o.end; s += 60)
+  {
+    struct Minute f;
+    bool dropped = false;
+
+    make_minute (&o, s, &f);
+    for (unsigned i = 0; i < o.drops; ++i)
+    {
+      dropped |= o.drop[i][0] <= s && s < o.drop[i][1];
+    };
+
+    for (unsigned i = 0; i < f.len; ++i, ++k)
+    {
+      /* Sekundenanfang in µs des Empfaengertakts */
+      const double t0 = o.offset + k * 1e6 * scale;
+      const double t1 = o.offset + (k + 1) * 1e6 * scale;
+
+      emit_until (t0 - JITTER_MAX);
+      ++secs;
+
+      /* Schwund als Poisson-Prozess mit exponentieller Dauer */
+      while (fade_start < t0)
+      {
+        fade_end = fade_start + exponential (o.fade_len * 1e6);
+        fade_start = fade_end + exponential (3600e6 / o.fades);
+      };
+      const bool fading = t0 < fade_end;
+      fade_secs += fading;
+
+      /* Sekunde 59 (ohne Schaltsekunde) und 60 ohne Absenkung */
+      if (i < 59 || (i == 59 && f.len == 61))
+      {
+        if (dropped || uniform () < o.missing || (fading && uniform () < FADE_MISSING))
+        {
+          ++missing;
+        }
+        else
+        {
+          const double a = t0 + o.delay_start + gauss (o.jitter);
+          const double w = (f.bits[i] ? 200000 : 100000) * scale + o.delay_end - o.delay_start + gauss (o.width_jitter);
+
+          toggle (a);
+          toggle (a + (w < 1 ? 1 : w));
+          ++pulses;
+        }
+      };
+
+      /* Stoerimpulse als Poisson-Prozess, im Schwund zusaetzlich */
+      while (next_glitch < t1)
+      {
+        toggle (next_glitch);
+        toggle (next_glitch + 1 + uniform () * o.glitch_len);
+        next_glitch += exponential (1e6 / o.glitches);
+        ++glitches;
+      };
+      for (unsigned g = 0; fading && g < FADE_GLITCHES; ++g)
+      {
+        const double at = t0 + uniform () * (t1 - t0);
+
+        toggle (at);
+        toggle (at + 1 + uniform () * o.glitch_len);
+        ++glitches;
+      }
+    }
+  };
+
+  /* letzte Minutenmarke noch zeigen, dann Ruhe */
+  const double t0 = o.offset + k * 1e6 * scale;
+  toggle (t0 + o.delay_start);
+  toggle (t0 + o.delay_start + 100000 * scale);
+  emit_until (UINT64_MAX);
+  out_flush ();
+  printf ("%" PRIu64 " 1\n", (uint64_t) (t0 + 1500000 * scale));
+
+  fprintf (stderr, "dcf77gen: %lu s, %lu pulses, %lu missing, %lu glitches, %lu s fading\n",
+           secs, pulses, missing, glitches, fade_secs);
+  return EXIT_SUCCESS;
+}
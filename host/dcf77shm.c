@@ -0,0 +1,505 @@
+/*
+ * $Header$
+ */
+
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "telegram.h"
+
+
+/*
+ * Refclock-Bruecke fuer Linux: liest das Zeittelegramm von der
+ * seriellen Schnittstelle (oder einem pty), nimmt die Empfangszeit des
+ * ersten Zeichens mit CLOCK_REALTIME direkt nach read() und zieht die
+ * Sendeverzoegerung der Firmware ab (-o, wie "emit" sie zeigt, plus
+ * die Dauer eines Zeichens).  Die Paare Telegrammzeit/Empfangszeit gehen
+ * an das NTP-SHM-Segment (ntpd refclock 127.127.28.u, chronyd refclock
+ * SHM u) und an einen chrony-SOCK-Refclock (-s).
+ *
+ * Formate: hopf6021, binary, zda.  Im Quarzbetrieb der Firmware werden
+ * keine Samples geliefert, ausser mit -q.
+ */
+
+
+/* ntpd refclock_shm.c */
+struct shmTime
+{
+  int mode;
+  volatile int count;
+  time_t clockTimeStampSec;
+  int clockTimeStampUSec;
+  time_t receiveTimeStampSec;
+  int receiveTimeStampUSec;
+  int leap;
+  int precision;
+  int nsamples;
+  volatile int valid;
+  unsigned clockTimeStampNSec;
+  unsigned receiveTimeStampNSec;
+  int dummy[8];
+};
+
+#define SHM_KEY         0x4e545030
+
+/* chrony refclock_sock.c */
+struct sock_sample
+{
+  struct timeval tv;
+  double offset;
+  int pulse;
+  int leap;
+  int _pad;
+  int magic;
+};
+
+#define SOCK_MAGIC      0x534f434b
+
+#define LEAP_NOWARNING  0
+#define LEAP_ADDSECOND  1
+
+
+enum Format
+{
+  F_HOPF6021, F_BINARY, F_ZDA
+};
+
+
+static const struct
+{
+  const char *name;
+  char start;
+  uint8_t len;
+}
+formats[] =
+{
+  [F_HOPF6021]  = { "hopf6021", '\x02', 18 },
+  [F_BINARY]    = { "binary",   TG_SYNC0, TG_LEN },
+  [F_ZDA]       = { "zda",      '$', 38 },
+};
+
+
+static enum Format format = F_HOPF6021;
+static long emit_offset_ns = 7812500;
+static long char_ns = 10 * 1000000000L / 9600;
+static bool verbose, quartz_ok;
+static volatile struct shmTime *shm;
+static int sock_fd = -1;
+
+
+static void usage (void)
+{
+  fprintf (stderr,
+           "usage: dcf77shm [-f hopf6021|binary|zda] [-b baud] [-o emit-offset-µs]\n"
+           "                [-u shm-unit] [-s chrony-sock] [-q] [-v] device\n");
+  exit (EXIT_FAILURE);
+}
+
+
+/********************
+ * serielle Leitung *
+ ********************/
+
+static speed_t baud_const (long baud)
+{
+  static const struct { long baud; speed_t speed; } speeds[] =
+  {
+    { 300, B300 }, { 600, B600 }, { 1200, B1200 }, { 2400, B2400 },
+    { 4800, B4800 }, { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+  };
+
+  for (size_t i = 0; i < sizeof speeds / sizeof speeds[0]; ++i)
+  {
+    if (speeds[i].baud == baud)
+    {
+      return speeds[i].speed;
+    }
+  };
+  fprintf (stderr, "dcf77shm: unsupported baud rate %ld\n", baud);
+  exit (EXIT_FAILURE);
+}
+
+
+static int open_line (const char *device, long baud)
+{
+  const int fd = open (device, O_RDONLY | O_NOCTTY);
+  struct termios tio;
+
+  if (fd < 0)
+  {
+    perror (device);
+    exit (EXIT_FAILURE);
+  };
+  if (tcgetattr (fd, &tio) == 0)
+  {
+    cfmakeraw (&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed (&tio, baud_const (baud));
+    cfsetospeed (&tio, baud_const (baud));
+    tcsetattr (fd, TCSANOW, &tio);
+  };
+
+  /* kuerzeste Latenz des UART-Treibers, ein pty kennt das nicht */
+  struct serial_struct ss;
+  if (ioctl (fd, TIOCGSERIAL, &ss) == 0)
+  {
+    ss.flags |= ASYNC_LOW_LATENCY;
+    ioctl (fd, TIOCSSERIAL, &ss);
+  };
+  return fd;
+}
+
+
+/************
+ * Ausgaben *
+ ************/
+
+static void open_shm (int unit)
+{
+  /* wie ntpd: Einheiten 0 und 1 nur fuer root */
+  const int id = shmget (SHM_KEY + unit, sizeof (struct shmTime), IPC_CREAT | (unit < 2 ? 0600 : 0666));
+
+  if (id < 0)
+  {
+    perror ("shmget");
+    exit (EXIT_FAILURE);
+  };
+  shm = shmat (id, NULL, 0);
+  if (shm == (void *) -1)
+  {
+    perror ("shmat");
+    exit (EXIT_FAILURE);
+  };
+}
+
+
+static void open_sock (const char *path)
+{
+  struct sockaddr_un sa = { .sun_family = AF_UNIX };
+
+  strncpy (sa.sun_path, path, sizeof sa.sun_path - 1);
+  sock_fd = socket (AF_UNIX, SOCK_DGRAM, 0);
+  if (sock_fd < 0)
+  {
+    perror ("socket");
+    exit (EXIT_FAILURE);
+  };
+
+  /* chronyd legt den Socket an, bis dahin gehen die Samples verloren */
+  if (connect (sock_fd, (struct sockaddr *) &sa, sizeof sa) < 0)
+  {
+    fprintf (stderr, "dcf77shm: %s: %s, retrying\n", path, strerror (errno));
+  }
+}
+
+
+static void publish_shm (const struct timespec *clock, const struct timespec *receive, int leap)
+{
+  /* Modus 1: count umrahmt die Aenderung, valid gibt frei */
+  shm->mode = 1;
+  shm->valid = 0;
+  ++shm->count;
+  __sync_synchronize ();
+  shm->clockTimeStampSec = clock->tv_sec;
+  shm->clockTimeStampUSec = clock->tv_nsec / 1000;
+  shm->clockTimeStampNSec = clock->tv_nsec;
+  shm->receiveTimeStampSec = receive->tv_sec;
+  shm->receiveTimeStampUSec = receive->tv_nsec / 1000;
+  shm->receiveTimeStampNSec = receive->tv_nsec;
+  shm->leap = leap;
+  shm->precision = -10;
+  shm->nsamples = 3;
+  __sync_synchronize ();
+  ++shm->count;
+  shm->valid = 1;
+}
+
+
+static void publish_sock (const char *path, const struct timespec *clock, const struct timespec *receive, int leap)
+{
+  struct sock_sample s =
+  {
+    .tv = { .tv_sec = receive->tv_sec, .tv_usec = receive->tv_nsec / 1000 },
+    .offset = (clock->tv_sec - receive->tv_sec) + (clock->tv_nsec - receive->tv_nsec) * 1e-9,
+    .leap = leap,
+    .magic = SOCK_MAGIC,
+  };
+
+  if (send (sock_fd, &s, sizeof s, 0) < 0)
+  {
+    /* chronyd neu gestartet: neu verbinden */
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    strncpy (sa.sun_path, path, sizeof sa.sun_path - 1);
+    connect (sock_fd, (struct sockaddr *) &sa, sizeof sa);
+  }
+}
+
+
+/**********
+ * Parser *
+ **********/
+
+static int hex (char c)
+{
+  return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+
+static int num (const char *p, int n)
+{
+  int v = 0;
+
+  while (n--)
+  {
+    if (*p < '0' || *p > '9')
+    {
+      return -1;
+    };
+    v = v * 10 + *p++ - '0';
+  };
+  return v;
+}
+
+
+static time_t utc (int yr, int mon, int day, int hr, int min, int sec)
+{
+  struct tm tm =
+  {
+    .tm_year = yr - 1900, .tm_mon = mon - 1, .tm_mday = day,
+    .tm_hour = hr, .tm_min = min, .tm_sec = sec,
+  };
+
+  return timegm (&tm);
+}
+
+
+/* Telegrammzeit in UTC, -1 = ungueltig */
+static time_t parse (const uint8_t *f, bool *quartz, int *leap)
+{
+  *leap = LEAP_NOWARNING;
+
+  switch (format)
+  {
+    case F_HOPF6021:
+      {
+        const char *s = (const char *) f;
+        const int st = hex (s[1]) << 4 | hex (s[2]);
+        const int hr = num (s + 3, 2), min = num (s + 5, 2), sec = num (s + 7, 2);
+        const int day = num (s + 9, 2), mon = num (s + 11, 2), yr = num (s + 13, 2);
+
+        if (st < 0 || hr < 0 || min < 0 || sec < 0 || day < 0 || mon < 0 || yr < 0 || s[17] != '\x03')
+        {
+          return -1;
+        };
+        *quartz = !(st & 0b10000000);
+        return utc (2000 + yr, mon, day, hr, min, sec) - (st & 0b00100000 ? 7200 : 3600);
+      }
+
+    case F_BINARY:
+      {
+        uint16_t crc = 0xFFFF;
+
+        for (int i = TG_EPOCH; i < TG_CRC; ++i)
+        {
+          crc = telegram_crc16 (crc, f[i]);
+        };
+        if (f[1] != TG_SYNC1 || crc != (f[TG_CRC] | f[TG_CRC+1] << 8))
+        {
+          return -1;
+        };
+        *quartz = f[TG_STATUS] & TG_QUARTZ;
+        *leap = f[TG_STATUS] & TG_LEAP ? LEAP_ADDSECOND : LEAP_NOWARNING;
+        return (time_t) f[TG_EPOCH] | f[TG_EPOCH+1] << 8 | f[TG_EPOCH+2] << 16 | (time_t) f[TG_EPOCH+3] << 24;
+      }
+
+    case F_ZDA:
+      {
+        const char *s = (const char *) f;
+        uint8_t cs = 0;
+        int i = 1;
+
+        for (; i < formats[F_ZDA].len && s[i] != '*'; ++i)
+        {
+          cs ^= s[i];
+        };
+        if (strncmp (s, "$GPZDA,", 7) != 0 || i > 33 || hex (s[i+1]) << 4 != (cs & 0xF0) || hex (s[i+2]) != (cs & 0x0F))
+        {
+          return -1;
+        };
+        *quartz = false;
+        return utc (num (s + 23, 4), num (s + 20, 2), num (s + 17, 2),
+                    num (s + 7, 2), num (s + 9, 2), num (s + 11, 2));
+      }
+  };
+  return -1;
+}
+
+
+int main (int argc, char **argv)
+{
+  const char *sock_path = NULL;
+  long baud = 9600;
+  int unit = 0, opt;
+
+  while ((opt = getopt (argc, argv, "f:b:o:u:s:qv")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f':
+        for (format = 0; format < sizeof formats / sizeof formats[0] && strcmp (optarg, formats[format].name) != 0; ++format)
+        {
+        };
+        if (format == sizeof formats / sizeof formats[0])
+        {
+          usage ();
+        };
+        break;
+
+      case 'b':
+        baud = strtol (optarg, NULL, 0);
+        break;
+
+      case 'o':
+        emit_offset_ns = strtol (optarg, NULL, 0) * 1000;
+        break;
+
+      case 'u':
+        unit = strtol (optarg, NULL, 0);
+        break;
+
+      case 's':
+        sock_path = optarg;
+        break;
+
+      case 'q':
+        quartz_ok = true;
+        break;
+
+      case 'v':
+        verbose = true;
+        break;
+
+      default:
+        usage ();
+    }
+  };
+  if (optind != argc - 1)
+  {
+    usage ();
+  };
+
+  const int fd = open_line (argv[optind], baud);
+  char_ns = 10 * 1000000000L / baud;
+  open_shm (unit);
+  if (sock_path)
+  {
+    open_sock (sock_path);
+  };
+
+  uint8_t frame[64];
+  int n = 0;
+  struct timespec start = { 0 };
+
+  for (;;)
+  {
+    uint8_t buf[64];
+    const ssize_t k = read (fd, buf, sizeof buf);
+    struct timespec now;
+
+    clock_gettime (CLOCK_REALTIME, &now);
+    if (k <= 0)
+    {
+      if (k < 0 && errno == EINTR)
+      {
+        continue;
+      };
+      return k < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    };
+
+    for (ssize_t i = 0; i < k; ++i)
+    {
+      if (n == 0)
+      {
+        if (buf[i] != formats[format].start)
+        {
+          continue;
+        };
+
+        /* das letzte Zeichen von read() kam zu now, die davor je ein Zeichen frueher */
+        const long back = (k - 1 - i) * char_ns;
+        start = now;
+        start.tv_nsec -= back % 1000000000L;
+        start.tv_sec -= back / 1000000000L;
+        if (start.tv_nsec < 0)
+        {
+          start.tv_nsec += 1000000000L;
+          --start.tv_sec;
+        }
+      };
+      frame[n++] = buf[i];
+      if (n < formats[format].len)
+      {
+        continue;
+      };
+      n = 0;
+
+      bool quartz;
+      int leap;
+      const time_t t = parse (frame, &quartz, &leap);
+      if (t < 0)
+      {
+        if (verbose)
+        {
+          fprintf (stderr, "dcf77shm: bad telegram\n");
+        };
+        continue;
+      };
+
+      /* Ende des ersten Zeichens nach der Sekundenmarke */
+      struct timespec clock = { .tv_sec = t, .tv_nsec = emit_offset_ns + char_ns };
+      while (clock.tv_nsec >= 1000000000L)
+      {
+        clock.tv_nsec -= 1000000000L;
+        ++clock.tv_sec;
+      };
+
+      if (verbose)
+      {
+        printf ("%ld.%09ld %ld.%09ld %+.6f%s\n",
+                (long) clock.tv_sec, clock.tv_nsec, (long) start.tv_sec, start.tv_nsec,
+                (clock.tv_sec - start.tv_sec) + (clock.tv_nsec - start.tv_nsec) * 1e-9,
+                quartz ? " quartz" : "");
+        fflush (stdout);
+      };
+      if (quartz && !quartz_ok)
+      {
+        continue;
+      };
+      publish_shm (&clock, &start, leap);
+      if (sock_path)
+      {
+        publish_sock (sock_path, &clock, &start, leap);
+      }
+    }
+  }
+}
@@ -0,0 +1,122 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+
+/*
+ * Nativer Build des Decoders.  Das Signal an PD2 kommt zeilenweise
+ * als "<µs> <0|1>" (Pegel ab diesem Zeitpunkt, '#' = Kommentar) aus
+ * einer Datei oder von stdin, die UART-Ausgabe geht nach stdout.
+ * Mit -c wird nach dem Signalende eine Kommandozeile empfangen
+ * (DIP-Switch 8 aus, -s 0), mit -C schon ab Reset, mit -p der PPS-Ausgang im selben Format
+ * in eine Datei geschrieben.  -r laesst die Simulation in Echtzeit
+ * laufen, etwa mit stdout auf einem pty fuer host/dcf77shm.
+ */
+
+
+static FILE *signal_file;
+static unsigned long signal_line;
+
+
+static bool file_edge (uint64_t *cycle, bool *level)
+{
+  char line[128];
+
+  while (fgets (line, sizeof line, signal_file))
+  {
+    uint64_t us;
+    unsigned l;
+
+    ++signal_line;
+    if (line[0] == '#' || line[0] == '\n')
+    {
+      continue;
+    };
+    if (sscanf (line, "%" SCNu64 " %u", &us, &l) != 2 || l > 1)
+    {
+      fprintf (stderr, "dcf77sim: line %lu: bad signal record\n", signal_line);
+      exit (EXIT_FAILURE);
+    };
+    *cycle = SIM_US_TO_CYCLES(us);
+    *level = l;
+    return true;
+  };
+  return false;
+}
+
+
+static void usage (void)
+{
+  fprintf (stderr, "usage: dcf77sim [-s switches] [-c|-C console] [-p pps] [-r] [signal]\n");
+  exit (EXIT_FAILURE);
+}
+
+
+int main (int argc, char **argv)
+{
+  int opt;
+
+  while ((opt = getopt (argc, argv, "s:c:C:p:r")) != -1)
+  {
+    switch (opt)
+    {
+      case 's':
+        hal_switches_value = strtoul (optarg, NULL, 0);
+        break;
+
+      case 'C':
+        hal_console_at_reset = true;
+        /* wie -c, aber schon ab Reset */
+
+      case 'c':
+        {
+          /* Kommandozeile mit CR abschliessen */
+          char *console = malloc (strlen (optarg) + 2);
+          strcpy (console, optarg);
+          strcat (console, "\r");
+          hal_console = console;
+        };
+        break;
+
+      case 'r':
+        hal_realtime = true;
+        break;
+
+      case 'p':
+        hal_pps_file = fopen (optarg, "w");
+        if (!hal_pps_file)
+        {
+          perror (optarg);
+          return EXIT_FAILURE;
+        };
+        break;
+
+      default:
+        usage ();
+    }
+  };
+
+  if (optind < argc - 1)
+  {
+    usage ();
+  };
+  signal_file = optind < argc ? fopen (argv[optind], "r") : stdin;
+  if (!signal_file)
+  {
+    perror (argv[optind]);
+    return EXIT_FAILURE;
+  };
+
+  hal_next_edge = file_edge;
+  return firmware_main ();
+}
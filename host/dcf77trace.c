@@ -0,0 +1,168 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "telegram.h"
+#include "trace.h"
+
+
+/*
+ * Liest die Ausgabe des Kommandos trace aus einer Datei oder von
+ * stdin, synchronisiert sich auf TR_SYNC0/TR_SYNC1, prueft die CRC
+ * und gibt je Ereignis eine Zeile aus:
+ *
+ *   <Sekunden Timer 1> <+ms seit dem vorigen Ereignis> <Art> <Werte>
+ *
+ * Flanken zeigen zusaetzlich den genauen Abstand zur vorigen Flanke.
+ */
+
+
+static uint32_t get_le (const uint8_t *p, uint8_t n)
+{
+  uint32_t v = 0;
+
+  while (n--)
+  {
+    v = v << 8 | p[n];
+  };
+  return v;
+}
+
+
+/* prev_edge NULL: noch keine Flanke in diesem Auszug */
+static void print_event (const uint8_t *e, uint32_t prev, const uint32_t *prev_edge)
+{
+  const uint32_t t = get_le (e, 4);
+  const uint8_t type = e[4], a = e[5];
+  const uint16_t b = get_le (e + 6, 2);
+
+  printf ("%10.6f %+9.3fms ", (double) t / TIMER1VALUE_1S, (double) (int32_t) (t - prev) * 1000 / TIMER1VALUE_1S);
+  switch (type)
+  {
+    case TR_EDGE:
+      printf ("edge   ei_state=%u %s last_tcnt1~%u", a & 0x7F, a & 0x80 ? "ok" : "--", b * 32);
+      if (prev_edge)
+      {
+        printf (" dt=%.3fms", (double) (t - *prev_edge) * 1000 / TIMER1VALUE_1S);
+      };
+      printf ("\n");
+      break;
+
+    case TR_TI:
+      printf ("ti     ti_state=%u\n", a);
+      break;
+
+    case TR_BIT:
+      if (a == 0xFF)
+      {
+        printf ("bit    sec=%u not sampled\n", b >> 8);
+      }
+      else
+      {
+        printf ("bit    sec=%u bits=%u%u conf=%u%%\n", b >> 8, a >> 1 & 1, a & 1, b & 0xFF);
+      };
+      break;
+
+    case TR_STATE:
+      printf ("state  %u -> %u\n", b, a);
+      break;
+
+    case TR_ERROR:
+      printf ("error  %u line=%u\n", a, b);
+      break;
+
+    case TR_EMIT:
+      printf ("emit\n");
+      break;
+
+    case TR_LATE:
+      printf ("late   sec=%u\n", a);
+      break;
+
+    default:
+      printf ("?%u a=%u b=%u\n", type, a, b);
+      break;
+  }
+}
+
+
+int main (int argc, char **argv)
+{
+  FILE *in = argc > 1 ? fopen (argv[1], "rb") : stdin;
+  uint8_t f[TR_HEAD + TRACE_LEN * TR_EVENT + 2];
+  unsigned n = 0, len = TR_HEAD;
+  unsigned long crc_errors = 0;
+  int c;
+
+  if (argc > 2)
+  {
+    fprintf (stderr, "usage: dcf77trace [dump]\n");
+    return EXIT_FAILURE;
+  };
+  if (!in)
+  {
+    perror (argv[1]);
+    return EXIT_FAILURE;
+  };
+
+  while ((c = getc (in)) != EOF)
+  {
+    f[n++] = c;
+
+    /* Synchronisation */
+    if ((n == 1 && f[0] != TR_SYNC0) || (n == 2 && f[1] != TR_SYNC1) || (n == 3 && f[2] > TRACE_LEN))
+    {
+      n = f[n-1] == TR_SYNC0;
+      f[0] = TR_SYNC0;
+      continue;
+    };
+    if (n == 3)
+    {
+      len = TR_HEAD + f[2] * TR_EVENT + 2;
+    };
+    if (n < 3 || n < len)
+    {
+      continue;
+    };
+    n = 0;
+
+    uint16_t crc = 0xFFFF;
+    for (unsigned i = 2; i < len - 2; ++i)
+    {
+      crc = telegram_crc16 (crc, f[i]);
+    };
+    if (crc != get_le (f + len - 2, 2))
+    {
+      ++crc_errors;
+      continue;
+    };
+
+    printf ("# %u events%s, %" PRIu32 " lost\n", f[2], f[3] ? ", stopped by trigger" : "", get_le (f + 4, 2));
+    uint32_t prev = get_le (f + TR_HEAD, 4), prev_edge;
+    bool have_edge = false;
+    for (unsigned i = 0; i < f[2]; ++i)
+    {
+      const uint8_t *e = f + TR_HEAD + i * TR_EVENT;
+      print_event (e, prev, have_edge ? &prev_edge : NULL);
+      prev = get_le (e, 4);
+      if (e[4] == TR_EDGE)
+      {
+        prev_edge = prev;
+        have_edge = true;
+      }
+    };
+    fflush (stdout);
+  };
+
+  if (crc_errors)
+  {
+    fprintf (stderr, "dcf77trace: %lu CRC errors\n", crc_errors);
+  };
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,658 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "defs.h"
+#include "hal.h"
+#include "sim.h"
+
+
+/*
+ * Ereignisgesteuerte Simulation von Timer 0 (CTC), Timer 1 (frei
+ * laufend mit Compare A, Ueberlauf und Input Capture an der fallenden
+ * Flanke, Compare B schaltet den PPS-Ausgang), Timer 2 (CTC,
+ * Abtastung) und UART.  Die Zeit laeuft nur in hal_sleep() weiter,
+ * bis zum naechsten Interrupt.
+ */
+
+
+extern void INT0_vect (void);
+extern void TIMER0_COMP_vect (void);
+extern void TIMER2_COMP_vect (void);
+extern void TIMER1_CAPT_vect (void);
+extern void TIMER1_COMPA_vect (void);
+extern void TIMER1_COMPB_vect (void);
+extern void TIMER1_OVF_vect (void);
+extern void USART_UDRE_vect (void);
+extern void USART_RXC_vect (void);
+
+
+#define T1_PERIOD       ((uint64_t) 65536 * TIMER1PRESCALE)
+
+/* Timer 2: clk/64, OCR2 = 63 */
+#define T2_PERIOD       ((uint64_t) 64 * 64)
+
+/* ein Zeichen 8N1 bei 9600 Baud */
+#define RX_PERIOD       ((uint64_t) F_CPU * 10 / 9600)
+
+/* Nach Signalende noch so lange weiterlaufen (Konsole) */
+#define CONSOLE_IDLE    ((uint64_t) F_CPU)
+#define CONSOLE_MAX     ((uint64_t) 60 * F_CPU)
+
+
+uint64_t hal_cycles;
+uint8_t hal_switches_value = 0b10000000;
+const char *hal_console = "";
+bool hal_console_at_reset;
+FILE *hal_pps_file;
+bool hal_realtime;
+
+
+static bool no_edge (uint64_t *cycle, bool *level)
+{
+  return false;
+}
+
+
+bool (*hal_next_edge) (uint64_t *cycle, bool *level) = no_edge;
+
+
+static bool signal_level = HI;
+static bool int0_enabled, ticie1, toie1, timer0_enabled, timer2_enabled, ocie1a, ocie1b, pps_set, pps_level, rxcie, udrie, in_udre;
+static uint8_t ocr0;
+static uint16_t ocr1a, ocr1b, icr1;
+static uint64_t t0_zero, t0_next, t1_zero, t1a_next, t1b_next, t1ovf_next, t2_next;
+static bool edge_pending, signal_end;
+static uint64_t edge_cycle, end_cycle, console_cycle, rx_next;
+static bool edge_level;
+
+
+static uint64_t prescaled (uint64_t cycles, uint16_t prescale)
+{
+  return cycles - cycles % prescale;
+}
+
+
+static void hal_exit (void)
+{
+  fflush (stdout);
+  exit (EXIT_SUCCESS);
+}
+
+
+/******************
+ * Ein-/Ausgaenge *
+ ******************/
+
+void hal_init (void)
+{
+}
+
+
+bool hal_signal_state (void)
+{
+  return signal_level;
+}
+
+
+uint8_t hal_switches (void)
+{
+  return hal_switches_value;
+}
+
+
+void hal_pdn (bool on)
+{
+}
+
+
+/*********
+ * Timer *
+ *********/
+
+/* naechster Zeitpunkt > hal_cycles, an dem der Zaehler ab zero den Wert ocr erreicht */
+static uint64_t next_match (uint64_t zero, uint16_t ocr, uint16_t prescale, uint64_t period)
+{
+  uint64_t next = zero + (uint64_t) ocr * prescale;
+
+  if (next <= hal_cycles)
+  {
+    next += (hal_cycles - next) / period * period + period;
+  };
+  return next;
+}
+
+
+void hal_timer_init (void)
+{
+  ocr0 = TIMER0CMPVALUE - 1;
+  hal_set_tcnt0 (0);
+  t1_zero = prescaled (hal_cycles, TIMER1PRESCALE);
+  t1a_next = next_match (t1_zero, ocr1a, TIMER1PRESCALE, T1_PERIOD);
+  t1b_next = next_match (t1_zero, ocr1b, TIMER1PRESCALE, T1_PERIOD);
+  t1ovf_next = t1_zero + T1_PERIOD;
+  timer0_enabled = true;
+}
+
+
+/*
+ * Timer 0 stand zum Takt t0_zero (virtuell) auf 0, der naechste
+ * Compare-Match kommt bei OCR0.  Nach dem Match beginnt eine Taktstufe
+ * spaeter die neue Periode, OCR0 darf sich dazwischen aendern.
+ */
+static void t0_match (void)
+{
+  t0_next = t0_zero + (uint64_t) ocr0 * TIMER0PRESCALE;
+  if (t0_next <= hal_cycles)
+  {
+    /* Zaehler schon hinter OCR0: erst nach dem Ueberlauf */
+    t0_next += (uint64_t) 256 * TIMER0PRESCALE;
+  }
+}
+
+
+uint8_t hal_get_tcnt0 (void)
+{
+  /* wie auf dem Chip steht TCNT0 im Interrupt schon auf 0 */
+  return hal_cycles < t0_zero ? 0 : (hal_cycles - t0_zero) / TIMER0PRESCALE;
+}
+
+
+void hal_set_tcnt0 (uint8_t v)
+{
+  t0_zero = prescaled (hal_cycles, TIMER0PRESCALE) - (uint64_t) v * TIMER0PRESCALE;
+  t0_match ();
+}
+
+
+void hal_set_ocr0 (uint8_t v)
+{
+  ocr0 = v;
+  t0_match ();
+}
+
+
+uint16_t hal_get_tcnt1 (void)
+{
+  return (hal_cycles - t1_zero) / TIMER1PRESCALE;
+}
+
+
+uint16_t hal_get_icr1 (void)
+{
+  return icr1;
+}
+
+
+/* Ueberlauf zum aktuellen Takt, sein Interrupt kommt nach dem laufenden */
+bool hal_t1_overflow (void)
+{
+  return toie1 && t1ovf_next <= hal_cycles;
+}
+
+
+void hal_set_ocr1a (uint16_t v)
+{
+  ocr1a = v;
+  t1a_next = next_match (t1_zero, ocr1a, TIMER1PRESCALE, T1_PERIOD);
+}
+
+
+/* ohne Interrupt-Latenz geht kein Match verloren, Freigeben zaehlt ab jetzt */
+void hal_ocie1a (bool on)
+{
+  ocie1a = on;
+  t1a_next = next_match (t1_zero, ocr1a, TIMER1PRESCALE, T1_PERIOD);
+}
+
+
+void hal_clear_ocf1a (void)
+{
+}
+
+
+void hal_ocie1b (bool on)
+{
+  ocie1b = on;
+  t1b_next = next_match (t1_zero, ocr1b, TIMER1PRESCALE, T1_PERIOD);
+}
+
+
+void hal_clear_ocf1b (void)
+{
+}
+
+
+void hal_set_ocr1b (uint16_t v)
+{
+  ocr1b = v;
+  t1b_next = next_match (t1_zero, ocr1b, TIMER1PRESCALE, T1_PERIOD);
+}
+
+
+void hal_pps_set_on_match (bool set)
+{
+  pps_set = set;
+}
+
+
+/* Host: TSC-Takte statt AVR-Takten; UDRE laeuft verschachtelt, daher mehrere Startwerte */
+static uint64_t tsc_start[8];
+static uint8_t tsc_next;
+
+
+uint16_t hal_cycles_start (void)
+{
+  const uint8_t i = tsc_next++ % LENGTH (tsc_start);
+
+  tsc_start[i] = __builtin_ia32_rdtsc ();
+  return i;
+}
+
+
+uint16_t hal_cycles_stop (uint16_t tcnt1)
+{
+  const uint64_t cycles = __builtin_ia32_rdtsc () - tsc_start[tcnt1];
+  return cycles > UINT16_MAX ? UINT16_MAX : cycles;
+}
+
+
+/* die Simulation ruft jede ISR genau zum Ereignis auf */
+uint16_t hal_latency_t0 (void)
+{
+  return 0;
+}
+
+
+uint16_t hal_latency_t2 (void)
+{
+  return 0;
+}
+
+
+uint16_t hal_latency_capt (void)
+{
+  return 0;
+}
+
+
+uint16_t hal_latency_compa (void)
+{
+  return 0;
+}
+
+
+uint16_t hal_latency_compb (void)
+{
+  return 0;
+}
+
+
+uint16_t hal_latency_ovf (void)
+{
+  return 0;
+}
+
+
+/**************************
+ * Sekundenimpuls an OC1B *
+ **************************/
+
+void hal_pps_init (void)
+{
+}
+
+
+/* Pegelwechsel am PPS-Ausgang wie das Eingangssignal protokollieren */
+static void pps_output (bool level)
+{
+  if (level != pps_level && hal_pps_file)
+  {
+    fprintf (hal_pps_file, "%" PRIu64 " %u\n", SIM_CYCLES_TO_US(hal_cycles), level);
+  };
+  pps_level = level;
+}
+
+
+/*********************
+ * Timer 2 Abtastung *
+ *********************/
+
+void hal_sample_init (void)
+{
+}
+
+
+/* Timer 2 steht ohne Takt, gestartet kommt der erste Match nach einer Periode */
+void hal_sample_run (bool on)
+{
+  t2_next = prescaled (hal_cycles, 64) + T2_PERIOD;
+  timer2_enabled = on;
+}
+
+
+void hal_power_init (void)
+{
+}
+
+
+/*****************
+ * Input Capture *
+ *****************/
+
+void hal_capture_init (void)
+{
+  ticie1 = toie1 = true;
+}
+
+
+void hal_int0 (bool on)
+{
+  int0_enabled = on;
+}
+
+
+/********
+ * UART *
+ ********/
+
+void hal_uart_init (uint8_t baudrate, uint8_t databits, uint8_t stopbits, uint8_t parity)
+{
+  rxcie = true;
+}
+
+
+static bool rx_pending (void)
+{
+  return rxcie && (signal_end || hal_console_at_reset) && *hal_console;
+}
+
+
+uint8_t hal_uart_status (void)
+{
+  return HAL_UART_UDRE | HAL_UART_TXC | (rx_pending () ? HAL_UART_RXC : 0);
+}
+
+
+uint8_t hal_uart_getc (void)
+{
+  console_cycle = hal_cycles;
+  return *hal_console ? *hal_console++ : 0;
+}
+
+
+void hal_uart_putc (uint8_t c)
+{
+  putchar (c);
+  if (hal_realtime)
+  {
+    fflush (stdout);
+  }
+}
+
+
+/* Das Senderegister ist sofort wieder frei, UDRE feuert bis UDRIE aus ist */
+void hal_uart_udrie (bool on)
+{
+  udrie = on;
+  if (!in_udre)
+  {
+    in_udre = true;
+    while (udrie)
+    {
+      USART_UDRE_vect ();
+    };
+    in_udre = false;
+  }
+}
+
+
+/*********
+ * Reset *
+ *********/
+
+void hal_reset (void)
+{
+  fprintf (stderr, "reset at %" PRIu64 " cycles\n", hal_cycles);
+  hal_exit ();
+}
+
+
+/************
+ * Speicher *
+ ************/
+
+/* nicht simuliert: der native Build hat keinen bemalten Stack */
+void hal_mem (struct HalMem *m)
+{
+  *m = (struct HalMem) { 0 };
+}
+
+
+/*********
+ * Sleep *
+ *********/
+
+/* bis zum Takt t warten, der erste Aufruf legt den Bezug fest */
+static void realtime_wait (uint64_t t)
+{
+  static struct timespec zero;
+  static bool started;
+
+  if (!started)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &zero);
+    started = true;
+  };
+
+  const uint64_t us = SIM_CYCLES_TO_US(t);
+  struct timespec due =
+  {
+    .tv_sec  = zero.tv_sec + us / 1000000,
+    .tv_nsec = zero.tv_nsec + us % 1000000 * 1000,
+  };
+  if (due.tv_nsec >= 1000000000)
+  {
+    due.tv_nsec -= 1000000000;
+    ++due.tv_sec;
+  };
+  clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+}
+
+
+void hal_sleep (void)
+{
+  for (;;)
+  {
+    if (!edge_pending && !signal_end)
+    {
+      edge_pending = hal_next_edge (&edge_cycle, &edge_level);
+      if (!edge_pending)
+      {
+        signal_end = true;
+        end_cycle = console_cycle = hal_cycles;
+        rx_next = hal_cycles + RX_PERIOD;
+      }
+      else if (edge_cycle < hal_cycles)
+      {
+        edge_cycle = hal_cycles;
+      }
+    };
+
+    if (signal_end
+        &&
+        ((!*hal_console && hal_cycles - console_cycle >= CONSOLE_IDLE)
+         ||
+         hal_cycles - end_cycle >= CONSOLE_MAX))
+    {
+      hal_exit ();
+    };
+
+    /* naechstes Ereignis, bei Gleichstand in Vektorreihenfolge */
+    enum { NONE, EDGE, T2, T1A, T1B, T1OVF, T0, RX } ev = NONE;
+    uint64_t t = UINT64_MAX;
+
+    if (edge_pending && edge_cycle < t)
+    {
+      ev = EDGE, t = edge_cycle;
+    };
+    if (timer2_enabled && t2_next < t)
+    {
+      ev = T2, t = t2_next;
+    };
+    if (ocie1a && t1a_next < t)
+    {
+      ev = T1A, t = t1a_next;
+    };
+    if (ocie1b && t1b_next < t)
+    {
+      ev = T1B, t = t1b_next;
+    };
+    if (toie1 && t1ovf_next < t)
+    {
+      ev = T1OVF, t = t1ovf_next;
+    };
+    if (timer0_enabled && t0_next < t)
+    {
+      ev = T0, t = t0_next;
+    };
+    if (rx_pending () && rx_next < t)
+    {
+      ev = RX, t = rx_next;
+    };
+
+    if (hal_realtime && ev != NONE)
+    {
+      realtime_wait (t);
+    };
+
+    switch (ev)
+    {
+      case EDGE:
+        {
+          const bool falling = signal_level && !edge_level;
+          const bool change = signal_level != edge_level;
+
+          hal_cycles = edge_cycle;
+          signal_level = edge_level;
+          edge_pending = false;
+          if (change && int0_enabled)
+          {
+            INT0_vect ();
+          };
+          if (falling && ticie1)
+          {
+            icr1 = hal_get_tcnt1 ();
+            TIMER1_CAPT_vect ();
+            return;
+          };
+          if (change && int0_enabled)
+          {
+            return;
+          }
+        };
+        continue;
+
+      case T2:
+        hal_cycles = t2_next;
+        t2_next += T2_PERIOD;
+        TIMER2_COMP_vect ();
+        return;
+
+      case T1A:
+        hal_cycles = t1a_next;
+        t1a_next += T1_PERIOD;
+        TIMER1_COMPA_vect ();
+        return;
+
+      case T1B:
+        hal_cycles = t1b_next;
+        t1b_next += T1_PERIOD;
+        pps_output (pps_set);
+        TIMER1_COMPB_vect ();
+        return;
+
+      case T1OVF:
+        hal_cycles = t1ovf_next;
+        t1ovf_next += T1_PERIOD;
+        TIMER1_OVF_vect ();
+        return;
+
+      case T0:
+        hal_cycles = t0_next;
+        t0_zero = t0_next + TIMER0PRESCALE;
+        t0_match ();
+        TIMER0_COMP_vect ();
+        return;
+
+      case RX:
+        hal_cycles = rx_next;
+        rx_next += RX_PERIOD;
+        USART_RXC_vect ();
+        return;
+
+      default:
+        hal_exit ();
+    }
+  }
+}
+
+
+/**************
+ * BSD-String *
+ **************/
+
+size_t strlcpy (char *dst, const char *src, size_t size)
+{
+  const size_t len = strlen (src);
+
+  if (size > 0)
+  {
+    const size_t n = len < size ? len : size - 1;
+    memcpy (dst, src, n);
+    dst[n] = '\0';
+  };
+  return len;
+}
+
+
+/*******************
+ * avr-libc-Stream *
+ *******************/
+
+static FILE *fdev_stream;
+static int (*fdev_put) (char c, FILE *stream);
+
+
+void host_fdev_setup_stream (FILE *stream, int (*put) (char c, FILE *stream))
+{
+  fdev_stream = stream;
+  fdev_put = put;
+}
+
+
+int host_vfprintf (FILE *stream, const char *fmt, va_list ap)
+{
+  if (stream != fdev_stream)
+  {
+    return vfprintf (stream, fmt, ap);
+  };
+
+  char temp[256];
+  const int n = vsnprintf (temp, sizeof temp, fmt, ap);
+
+  for (int i = 0; i < n && i < (int) sizeof temp - 1; ++i)
+  {
+    fdev_put (temp[i], stream);
+  };
+  return n;
+}
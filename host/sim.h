@@ -0,0 +1,47 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _SIM_H
+#define _SIM_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+#define SIM_US_TO_CYCLES(us)    ((us) / 1000000 * F_CPU + (us) % 1000000 * F_CPU / 1000000)
+#define SIM_CYCLES_TO_US(c)     ((c) / F_CPU * 1000000 + (c) % F_CPU * 1000000 / F_CPU)
+
+
+/* simulierte CPU-Takte seit Reset */
+extern uint64_t hal_cycles;
+
+/* DIP-Switches wie von read_switches() geliefert (invertiert) */
+extern uint8_t hal_switches_value;
+
+/* UART-Eingabe, wird nach dem Ende des Signals empfangen */
+extern const char *hal_console;
+
+/* hal_console schon ab Reset empfangen, waehrend das Signal laeuft */
+extern bool hal_console_at_reset;
+
+/* simulierte Zeit an die Uhr binden, fuer ein pty als serielle Leitung */
+extern bool hal_realtime;
+
+/* Pegelwechsel an OC1B (PPS) als "<µs> <0|1>", NULL = keine */
+extern FILE *hal_pps_file;
+
+/*
+ * Signalquelle: naechster Pegel an PD2 ab Takt *cycle.
+ * false = Ende des Signals.
+ */
+extern bool (*hal_next_edge) (uint64_t *cycle, bool *level);
+
+/* main() der Firmware */
+extern int firmware_main (void);
+
+
+#endif
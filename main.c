@@ -6,15 +6,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
-#include <avr/io.h>
-#include <avr/wdt.h>
 #include <avr/pgmspace.h>
-#include <util/atomic.h>
-#include <util/delay.h>
+#include <avr/interrupt.h>
 
 #include "common.h"
 #include "switches.h"
@@ -22,139 +20,67 @@
 #include "uart.h"
 #include "timer.h"
 #include "timerint.h"
-#include "interrupt0.h"
+#include "timer1.h"
+#include "pll.h"
+#include "pps.h"
+#include "sample.h"
 #include "badint.h"
+#include "hal.h"
+#include "telegram.h"
+#include "calendar.h"
+#include "emit.h"
+#include "vote.h"
+#include "frame.h"
+#include "power.h"
+#include "prof.h"
+#include "trace.h"
+#include "capture.h"
 
 #include "defs.h"
 
 
-#define FORMAT_PZF5X    1
-#define FORMAT_HOPF6021 2
-
-#ifndef FORMAT
-#error
-#endif
-
-
 static const __flash char program_version[] = "1.1.3 " __DATE__ " " __TIME__;
 
 
-enum ProtocolState
-{
-  NOT_SYNCED = 0,
-  START_OF_MINUTE,
-  IGNORE_1,
-  IGNORE_2,
-  IGNORE_3,
-  IGNORE_4,
-  IGNORE_5,
-  IGNORE_6,
-  IGNORE_7,
-  IGNORE_8,
-  IGNORE_9,
-  IGNORE_10,
-  IGNORE_11,
-  IGNORE_12,
-  IGNORE_13,
-  IGNORE_14,
-  IGNORE_15,
-  NEW_TZ,
-  CEST,
-  CET,
-  LEAP,
-  START_TIME,
-  MIN_0,
-  MIN_1,
-  MIN_2,
-  MIN_3,
-  MIN_4,
-  MIN_5,
-  MIN_6,
-  PARITY_MIN,
-  HR_0,
-  HR_1,
-  HR_2,
-  HR_3,
-  HR_4,
-  HR_5,
-  PARITY_HR,
-  DAY_0,
-  DAY_1,
-  DAY_2,
-  DAY_3,
-  DAY_4,
-  DAY_5,
-  WDAY_0,
-  WDAY_1,
-  WDAY_2,
-  MON_0,
-  MON_1,
-  MON_2,
-  MON_3,
-  MON_4,
-  YR_0,
-  YR_1,
-  YR_2,
-  YR_3,
-  YR_4,
-  YR_5,
-  YR_6,
-  YR_7,
-  PARITY_DATE,
-  END_OF_MINUTE,
-};
-
-enum ERROR
-{
-  NO_ERROR,
-  E_STATE,
-  E_START_OF_MINUTE,
-  E_END_OF_MINUTE,
-  E_NOT_END_OF_MINUTE,
-  E_CET_CEST,
-  E_START_TIME,
-  E_PARITY_MIN,
-  E_PARITY_HR,
-  E_PARITY_DATE,
-  E_BIT_STATE,
-};
-
-
-
 static uint8_t sec, sec_max = 59;
+
+/*
+ * sec und sec_max gehoeren ti_S0.  Der Decoder meldet nur, welche
+ * Sekunde (Nummer aus dem BitEvent) Sekunde 0 war bzw. vor einer
+ * Schaltsekunde liegt; ti_S0 rechnet das auf die laufende Sekunde um.
+ */
+#define SEC_NONE        0xFF
+static volatile uint8_t sec_zero = SEC_NONE, sec_leap = SEC_NONE;
 static volatile bool new_time_info, inc_min;
 static bool valid_time_info, invalid_time_info;
 static bool valid_time_info_once, quartz_time;
 static bool pll_synced;
-static uint8_t ei_state, ti_state, last_ti_state, bit_state, bit_count[2];
-static uint16_t last_tcnt0, last_tcnt1;
+static uint8_t ei_state, ti_state, last_ti_state, bit_state, bit_count[2], bit_conf;
+static uint8_t minute_conf, min_conf = 100, no_pulse;
+static uint16_t last_tcnt0;
+static uint32_t last_tcnt1, edge_t1;
 static uint8_t state, err_state;
 static int err_line;
 static uint8_t last_err;
 static uint16_t err_count;
 static uint8_t switches_at_start;
 
-struct TimeInfo
+static struct TimeInfo time_info[2], cached_time_info, *wi, *ri;
+
+
+/* Bitereignisse vom Timer-0-Interrupt an die Hintergrundaktion */
+struct BitEvent
 {
-  char min[2], hr[2], day[2], wday[1], mon[2], yr[2];
-  bool tz_change, cet, cest, leap;
+  uint8_t sec, bits, conf;
+  uint32_t t1;
 };
 
-static struct TimeInfo time_info[2], cached_time_info, *wi, *ri;
-
-#define STX     "\x02"
-#define ETX     "\x03"
-#define CR      "\r"
-#define LF      "\n"
+#define CBUF_ID         b_
+#define CBUF_LEN        4
+#define CBUF_TYPE       struct BitEvent
+#include "cbuf.h"
 
-#if FORMAT == FORMAT_PZF5X
-/* Uni Erlangen time string for PZF5xx receivers (9600E72, NTP mode 2): */
-static char time_string[] = STX "dd.mm.yy; w; hh:mm:ss; tuvxyza" ETX;
-#endif
-#if FORMAT == FORMAT_HOPF6021
-/* Hopf 6021 receivers (9600N81, NTP mode 12): */
-static char time_string[] = STX "ABhhmmssddmmyy" LF CR ETX;
-#endif
+static struct b_CBuf bit_events;
 
 
 static const __flash struct
@@ -174,6 +100,38 @@ errors[] =
   [E_PARITY_HR          ]       FSTR("PARITY HOUR"),
   [E_PARITY_DATE        ]       FSTR("PARITY DATE"),
   [E_BIT_STATE          ]       FSTR("BIT STATE"),
+  [E_BIT_QUEUE          ]       FSTR("BIT QUEUE"),
+};
+
+
+static const __flash struct
+{
+  const __flash char *name;
+}
+pll_states[] =
+{
+  [PLL_UNLOCKED         ]       FSTR("UNLOCKED"),
+  [PLL_ACQUIRE          ]       FSTR("ACQUIRE"),
+  [PLL_LOCKED           ]       FSTR("LOCKED"),
+  [PLL_HOLDOVER         ]       FSTR("HOLDOVER"),
+};
+
+
+static const __flash struct
+{
+  const __flash char *name;
+}
+prof_vectors[] =
+{
+  [PROF_TIMER0_COMP     ]       FSTR("timer0_comp"),
+  [PROF_TIMER2_COMP     ]       FSTR("timer2_comp"),
+  [PROF_TIMER1_CAPT     ]       FSTR("timer1_capt"),
+  [PROF_TIMER1_COMPA    ]       FSTR("timer1_compa"),
+  [PROF_TIMER1_COMPB    ]       FSTR("timer1_compb"),
+  [PROF_TIMER1_OVF      ]       FSTR("timer1_ovf"),
+  [PROF_USART_RXC       ]       FSTR("usart_rxc"),
+  [PROF_USART_UDRE      ]       FSTR("usart_udre"),
+  [PROF_INT0            ]       FSTR("int0"),
 };
 
 
@@ -184,44 +142,32 @@ errors[] =
 
 static void reset_cpu (void)
 {
-  wdt_enable (WDTO_15MS);
-  cli ();
+  uart_drain ();
+  hal_reset ();
 }
 
 
-static void do_inc_min (void)
+static uint8_t next_sec (uint8_t s)
 {
-  if (cached_time_info.min[1] < '9')
-  {
-    ++cached_time_info.min[1];
-    return;
-  };
-
-  cached_time_info.min[1] = '0';
-  if (cached_time_info.min[0] < '5')
+  if (s < 59)
   {
-    ++cached_time_info.min[0];
-    return;
+    return s + 1;
   };
 
-  cached_time_info.min[0] = '0';
-  if ((cached_time_info.hr[0] < '2' && cached_time_info.hr[1] < '9')
-      ||
-      cached_time_info.hr[1] < '3')
+  /* Schaltsekunde am Ende der angekuendigten Stunde */
+  if (s == 59
+      &&
+      (sec_max == 60
+       ||
+       (cached_time_info.leap && cached_time_info.min[0] == '5' && cached_time_info.min[1] == '9')))
   {
-    ++cached_time_info.hr[1];
-    return;
+    return 60;
   };
+  return 0;
+}
 
-  cached_time_info.hr[1] = '0';
-  if (cached_time_info.hr[0] < '2')
-  {
-    ++cached_time_info.hr[0];
-    return;
-  };
 
-  cached_time_info.hr[0] = '0';
-}
+static void decode_bits (void);
 
 
 static void background (void)
@@ -234,68 +180,98 @@ static void background (void)
     return;
   };
 
-  static uint8_t prev_sec = 69;
+  decode_bits ();
+
+  static bool rerender, rendered_ahead, applied_sec0;
+  static uint16_t holdover_min;
 
-  if (new_time_info)
+  if (sec != 0)
   {
-    cached_time_info = *ri;
-    new_time_info = false;
-    valid_time_info_once = true;
-    quartz_time = false;
-  }
-  else if (inc_min && valid_time_info_once)
+    applied_sec0 = false;
+  };
+
+  if (new_time_info || inc_min)
   {
-    do_inc_min ();
-    quartz_time = true;
-    inc_min = false;
+    /* Paritaet allein reicht nicht, der Rahmen muss zu den letzten passen */
+    const bool accepted = vote_frame (new_time_info ? ri : NULL);
+
+    if (accepted)
+    {
+      cached_time_info = *ri;
+      valid_time_info_once = true;
+      quartz_time = false;
+      holdover_min = 0;
+    }
+    else if (valid_time_info_once)
+    {
+      calendar_inc_min (&cached_time_info);
+      quartz_time = true;
+      holdover_min += holdover_min < UINT16_MAX;
+    };
+    telegram_set_status (holdover_min, minute_conf);
+    new_time_info = inc_min = false;
+    rerender = true;
+    applied_sec0 = true;
   };
 
-  if (valid_time_info_once && prev_sec != sec)
+  if (valid_time_info_once && !emit_armed ())
   {
-    prev_sec = sec;
-#if FORMAT == FORMAT_PZF5X
-    snprintf_P (time_string,
-                sizeof time_string,
-                PSTR(STX "%02.2s.%02.2s.%02.2s; %1.1s; %02.2s:%02.2s:%02.2u; %c%c%c%c%c%c%c" ETX),
-                /*                                                            t u v x y z a */
-                cached_time_info.day,
-                cached_time_info.mon,
-                cached_time_info.yr,
-                cached_time_info.wday,
-                cached_time_info.hr,
-                cached_time_info.min,
-                prev_sec,
-                ' ',                                            /* t: Lokalzeit */
-                ' ',                                            /* u: wenigstens einmal synchronisiert */
-                quartz_time                ? '*' : ' ',         /* v: Quarz j/n */
-                cached_time_info.cest      ? 'S' : ' ',         /* x: Sommer-/Winterzeit */
-                cached_time_info.tz_change ? '!' : ' ',         /* y: Wechsel Sommer-/Winterzeit anstehend */
-                cached_time_info.leap      ? 'A' : ' ',         /* z: Schaltsekunde anstehend */
-                ' ');                                           /* a: */
-#endif
-#if FORMAT == FORMAT_HOPF6021
-    const uint8_t status =
-      (quartz_time                ? 0b01000000 : 0b11000000) |
-      (cached_time_info.cest      ? 0b00100000 : 0b00000000) |
-      (cached_time_info.tz_change ? 0b00010000 : 0b00000000) |
-      (cached_time_info.wday[0] & 0b00000111);
-    snprintf_P (time_string,
-                sizeof time_string,
-                PSTR(STX "%02.2X%02.2s%02.2s%02.2u%02.2s%02.2s%02.2s" LF CR ETX),
-                status,
-                cached_time_info.hr,
-                cached_time_info.min,
-                prev_sec,
-                cached_time_info.day,
-                cached_time_info.mon,
-                cached_time_info.yr);
-#endif
-    if (sw_no_debug ())
+    cli ();
+    const uint8_t s = sec;
+    uint32_t boundary = pll_boundary;
+    sei ();
+
+    /* naechste Sekunde, deren Freigabezeitpunkt noch bevorsteht */
+    uint8_t label = s;
+    if (!emit_in_time (boundary))
     {
-      /* Zeitinformation senden */
-      uart_puts (time_string);
+      label = next_sec (s);
+      boundary += TIMER1VALUE_1S;
+    };
+
+    /*
+     * Kurz nach einer Freigabe ist die neue Sekundenmarke erst mit
+     * dem naechsten Timer-0-Tick bekannt, bis dahin abwarten.
+     */
+    if (emit_due (boundary))
+    {
+      /* Sekunde der naechsten Minute, deren Zeitinformation erst in Sekunde 0 kommt */
+      const bool ahead = (label == 0 && s != 0) || (s == 0 && !applied_sec0);
+      if (ahead)
+      {
+        struct TimeInfo next_time_info = cached_time_info;
+        calendar_inc_min (&next_time_info);
+        telegram_render (&next_time_info, label, quartz_time);
+      }
+      else if (rerender || rendered_ahead)
+      {
+        telegram_render (&cached_time_info, label, quartz_time);
+        rerender = false;
+      }
+      else
+      {
+        telegram_set_sec (label);
+      };
+      rendered_ahead = ahead;
+
+      if (sw_no_debug ())
+      {
+        /* Zeitinformation bereitstellen, Timer 1 gibt sie frei */
+        uart_write (time_string, telegram_len);
+      };
+      if (!emit_arm (boundary))
+      {
+        uart_discard ();
+        trace (TR_LATE, label, 0, timer1_now ());
+      }
     }
-  }
+  };
+
+  if (pll_store_due)
+  {
+    pll_store_due = false;
+    pll_store ();
+  };
 
   if (read_switches () != switches_at_start)
   {
@@ -312,6 +288,16 @@ static void background (void)
 
 static void set_error (uint8_t err, int line)
 {
+  if (err != NO_ERROR)
+  {
+    trace (TR_ERROR, err, line, timer1_now ());
+
+    /* Empfangsabbruch: Fehler nach dem ersten gueltigen Rahmen festhalten */
+    if (valid_time_info_once)
+    {
+      trace_trigger ();
+    }
+  };
   if (last_err == NO_ERROR)
   {
     err_line = line;
@@ -335,6 +321,7 @@ static void not_synced (uint8_t err, int line)
 
 static void update_time_info (void)
 {
+  calendar_leap_done (wi);
   wi = wi == &time_info[1] ? &time_info[0] : &time_info[1],     /* SEQUENCE POINT */
   ri = wi == &time_info[1] ? &time_info[0] : &time_info[1];
   new_time_info = true;
@@ -346,12 +333,12 @@ static void update_time_info (void)
  * Protokollverarbeitung *
  *************************/
 
-static void protocol ()
+/* true: Minutenanfang erkannt, Sekunde s ist Sekunde 0 */
+static bool protocol (uint8_t s, uint8_t bits)
 {
-  static uint8_t parity;
   uint8_t bit = 0;
 
-  switch (bit_state)
+  switch (bits)
   {
     case 0b00:  /* "1" */
       bit = 1;
@@ -377,303 +364,112 @@ static void protocol ()
   {
     case NOT_SYNCED:
       valid_time_info = false;
-      return;
+      return false;
 
-    case START_OF_MINUTE:
-      if (bit != 0)
-      {
-        set_error (E_START_OF_MINUTE, __LINE__);
-        invalid_time_info = true;
-      }
-      else
+    case END_OF_MINUTE:
+      switch (bits)
       {
-        sec = 0;
-        invalid_time_info = false;
-      };
-      break;
-
-    case IGNORE_1:
-    case IGNORE_2:
-    case IGNORE_3:
-    case IGNORE_4:
-    case IGNORE_5:
-    case IGNORE_6:
-    case IGNORE_7:
-    case IGNORE_8:
-    case IGNORE_9:
-    case IGNORE_10:
-    case IGNORE_11:
-    case IGNORE_12:
-    case IGNORE_13:
-    case IGNORE_14:
-    case IGNORE_15:
-      break;
-
-    case NEW_TZ:
-      wi->tz_change = bit == 1;
-      break;
+        case 0b01:      // Schaltsekunde
+          sec_leap = s;
+          return false;
 
-    case CEST:
-      wi->cest = bit == 1;
-      break;
+        case 0b11:
+          state = START_OF_MINUTE;
+          return false;
 
-    case CET:
-      wi->cet = bit == 1;
-      if (wi->cet == wi->cest)
-      {
-        invalid_time_info = true;
-        set_error (E_CET_CEST, __LINE__);
+        default:
+          not_synced (E_END_OF_MINUTE, __LINE__);
+          return false;
       };
-      break;
 
-    case LEAP:
-      wi->leap = bit == 1;
-      break;
-
-    case START_TIME:
-      parity = 0;
-      wi->min[0] = '0';
-      wi->min[1] = '0';
-      if (bit != 1)
+    default:
+      if (state > END_OF_MINUTE)
       {
-        invalid_time_info = true;
-        set_error (E_START_TIME, __LINE__);
+        not_synced (E_STATE, __LINE__);
+        return false;
       };
       break;
+  };
 
-    case MIN_0:
-      parity ^= bit;
-      wi->min[1] |= (bit << 0);
-      break;
-
-    case MIN_1:
-      parity ^= bit;
-      wi->min[1] |= (bit << 1);
-      break;
-
-    case MIN_2:
-      parity ^= bit;
-      wi->min[1] |= (bit << 2);
-      break;
-
-    case MIN_3:
-      parity ^= bit;
-      wi->min[1] |= (bit << 3);
-      break;
-
-    case MIN_4:
-      parity ^= bit;
-      wi->min[0] |= (bit << 0);
-      break;
+  /* Sekunden 0..58 nach FRAME_LAYOUT */
+  const uint8_t err = frame_bit (wi, state, bit);
+  if (err != NO_ERROR)
+  {
+    invalid_time_info = true;
+    set_error (err, __LINE__);
+  }
+  else if (state == START_OF_MINUTE)
+  {
+    if (s != 0)
+    {
+      sec_zero = s;
+    };
+    invalid_time_info = false;
+  };
 
-    case MIN_5:
-      parity ^= bit;
-      wi->min[0] |= (bit << 1);
-      break;
+  if (state == PARITY_DATE)
+  {
+    valid_time_info = !invalid_time_info;
+  };
+  return state++ == START_OF_MINUTE && err == NO_ERROR;
+}
 
-    case MIN_6:
-      parity ^= bit;
-      wi->min[0] |= (bit << 2);
-      break;
 
-    case PARITY_MIN:
-      wi->hr[0] = '0';
-      wi->hr[1] = '0';
-      if (bit != parity)
-      {
-        invalid_time_info = true;
-        set_error (E_PARITY_MIN, __LINE__);
-      };
-      parity = 0;
-      break;
+/****************************
+ * Bitereignisse dekodieren *
+ ***************************/
 
-    case HR_0:
-      parity ^= bit;
-      wi->hr[1] |= (bit << 0);
-      break;
+static void decode_bits (void)
+{
+  cli ();
+  const bool overrun = b_get_overrun (&bit_events);
+  sei ();
+  if (overrun)
+  {
+    /* Sekunde verloren, der Rahmen passt nicht mehr */
+    not_synced (E_BIT_QUEUE, __LINE__);
+  };
 
-    case HR_1:
-      parity ^= bit;
-      wi->hr[1] |= (bit << 1);
-      break;
+  while (!b_empty (&bit_events))
+  {
+    const struct BitEvent ev = b_get (&bit_events);
 
-    case HR_2:
-      parity ^= bit;
-      wi->hr[1] |= (bit << 2);
-      break;
+    if (ev.bits == 0b11)
+    {
+      ++no_pulse;
+    }
+    else if (ev.conf < min_conf)
+    {
+      min_conf = ev.conf;
+    };
 
-    case HR_3:
-      parity ^= bit;
-      wi->hr[1] |= (bit << 3);
-      break;
+    const uint8_t before = state;
+    const bool minute = protocol (ev.sec, ev.bits);
 
-    case HR_4:
-      parity ^= bit;
-      wi->hr[0] |= (bit << 0);
-      break;
+    /* nur Spruenge, das Weiterzaehlen ergibt sich aus den Bits */
+    if (state != before && state != (uint8_t) (before + 1))
+    {
+      trace (TR_STATE, state, before, timer1_now ());
+    };
 
-    case HR_5:
-      parity ^= bit;
-      wi->hr[0] |= (bit << 1);
-      break;
+    if (minute || ev.sec == 0)
+    {
+      /* schlechtestes Bit der abgelaufenen Minute, 0 bei fehlenden Impulsen */
+      minute_conf = no_pulse > 1 ? 0 : min_conf;
+      min_conf = 100;
+      no_pulse = 0;
 
-    case PARITY_HR:
-      wi->day[0] = '0';
-      wi->day[1] = '0';
-      if (bit != parity)
+      if (valid_time_info)
       {
-        invalid_time_info = true;
-        set_error (E_PARITY_HR, __LINE__);
-      };
-      parity = 0;
-      break;
-
-    case DAY_0:
-      parity ^= bit;
-      wi->day[1] |= (bit << 0);
-      break;
-
-    case DAY_1:
-      parity ^= bit;
-      wi->day[1] |= (bit << 1);
-      break;
-
-    case DAY_2:
-      parity ^= bit;
-      wi->day[1] |= (bit << 2);
-      break;
-
-    case DAY_3:
-      parity ^= bit;
-      wi->day[1] |= (bit << 3);
-      break;
-
-    case DAY_4:
-      parity ^= bit;
-      wi->day[0] |= (bit << 0);
-      break;
-
-    case DAY_5:
-      parity ^= bit;
-      wi->day[0] |= (bit << 1);
-      wi->wday[0] = '0';
-      break;
-
-    case WDAY_0:
-      parity ^= bit;
-      wi->wday[0] |= (bit << 0);
-      break;
-
-    case WDAY_1:
-      parity ^= bit;
-      wi->wday[0] |= (bit << 1);
-      break;
-
-    case WDAY_2:
-      parity ^= bit;
-      wi->wday[0] |= (bit << 2);
-      wi->mon[0] = '0';
-      wi->mon[1] = '0';
-      break;
-
-    case MON_0:
-      parity ^= bit;
-      wi->mon[1] |= (bit << 0);
-      break;
-
-    case MON_1:
-      parity ^= bit;
-      wi->mon[1] |= (bit << 1);
-      break;
-
-    case MON_2:
-      parity ^= bit;
-      wi->mon[1] |= (bit << 2);
-      break;
-
-    case MON_3:
-      parity ^= bit;
-      wi->mon[1] |= (bit << 3);
-      break;
-
-    case MON_4:
-      parity ^= bit;
-      wi->mon[0] |= (bit << 0);
-      wi->yr[0] = '0';
-      wi->yr[1] = '0';
-      break;
-
-    case YR_0:
-      parity ^= bit;
-      wi->yr[1] |= (bit << 0);
-      break;
-
-    case YR_1:
-      parity ^= bit;
-      wi->yr[1] |= (bit << 1);
-      break;
-
-    case YR_2:
-      parity ^= bit;
-      wi->yr[1] |= (bit << 2);
-      break;
-
-    case YR_3:
-      parity ^= bit;
-      wi->yr[1] |= (bit << 3);
-      break;
-
-    case YR_4:
-      parity ^= bit;
-      wi->yr[0] |= (bit << 0);
-      break;
-
-    case YR_5:
-      parity ^= bit;
-      wi->yr[0] |= (bit << 1);
-      break;
-
-    case YR_6:
-      parity ^= bit;
-      wi->yr[0] |= (bit << 2);
-      break;
-
-    case YR_7:
-      parity ^= bit;
-      wi->yr[0] |= (bit << 3);
-      break;
-
-    case PARITY_DATE:
-      if (bit != parity)
+        update_time_info ();
+      }
+      else
       {
-        invalid_time_info = true;
-        set_error (E_PARITY_DATE, __LINE__);
+        inc_min = true;
       };
-      valid_time_info = !invalid_time_info;
-      break;
-
-    case END_OF_MINUTE:
-      switch (bit_state)
-      {
-        case 0b01:      // Schaltsekunde
-          sec_max = 60;
-          return;
-
-        case 0b11:
-          state = START_OF_MINUTE;
-          return;
-
-        default:
-          not_synced (E_END_OF_MINUTE, __LINE__);
-          return;
-      };
-
-    default:
-      not_synced (E_STATE, __LINE__);
-      return;
-  };
-
-  ++state;
+      valid_time_info = false;
+    }
+  }
 }
 
 
@@ -681,19 +477,17 @@ static void protocol ()
  * Timerinterrupt *
  ******************/
 
+/*
+ * Timer 0 weckt nur zweimal je Sekunde: kurz nach der Sekundenmarke
+ * (Sekunde zaehlen, PLL weiterstellen, Abtastung starten) und nach dem
+ * Ende von Fenster B (Bit auswerten).
+ */
+#define TI_LAG          US_TO_T1(TIMER0USECS / 2)
+#define TI_DECIDE       ((uint32_t) (SAMPLE_B1 + 2) * (TIMER1VALUE_1S / SAMPLE_HZ))
+
+
 static void ti_S0 ();
 static void ti_S1 ();
-static void ti_S2 ();
-static void ti_S3 ();
-static void ti_S4 ();
-static void ti_S5 ();
-static void ti_S6 ();
-static void ti_S7 ();
-static void ti_S8 ();
-static void ti_S9 ();
-static void ti_S10 ();
-static void ti_S11 ();
-static void ti_S12 ();
 
 
 #define ti_STATE(n)                     \
@@ -701,130 +495,91 @@ static void ti_S12 ();
   {                                     \
     ti_state = n;                       \
     timerint0_callback = XCAT(ti_S,n);  \
+    trace_put (TR_TI, n, 0, timer1_get ()); \
   }                                     \
   while (false);
 
 
 static void ti_S0 ()
 {
-  if (pll_synced)
+  /* Meldungen des Decoders, auch wenn er Sekunden hinterherhinkt */
+  if (sec_zero != SEC_NONE)
   {
-    ti_STATE(1);
-    if (++sec > sec_max)
+    sec = (sec + 60 - sec_zero) % 60;
+    sec_max = 59;
+    sec_zero = SEC_NONE;
+  };
+  if (sec_leap != SEC_NONE)
+  {
+    /* nur rechtzeitig, sonst stellt der naechste Minutenanfang die Sekunde */
+    if (sec_leap == sec)
     {
-      sec = 0;
-      sec_max = 59;
-    }
-  }
-}
-
-#define SIGNAL_STATE()  (!!(PIND & _BV(PD2)))
-
-
-static void ti_S1 ()
-{
-  bit_count[0] = SIGNAL_STATE();
-  ti_STATE(2);
-}
-
-
-static void ti_S2 ()
-{
-  bit_count[0] += SIGNAL_STATE();
-  ti_STATE(3);
-}
-
-
-static void ti_S3 ()
-{
-  bit_count[0] += SIGNAL_STATE();
-  ti_STATE(4);
-}
-
-
-static void ti_S4 ()
-{
-  bit_state = bit_count[0] <= 1 ? 0b00 : 0b10;
-  ti_STATE(5);
-}
-
-
-static void ti_S5 ()
-{
-  ti_STATE(6);
-}
-
+      sec_max = 60;
+    };
+    sec_leap = SEC_NONE;
+  };
 
-static void ti_S6 ()
-{
-  ti_STATE(7);
-}
+  if (++sec > sec_max)
+  {
+    sec = 0;
+    sec_max = 59;
+  };
 
+  /* Sekundenmarke von der PLL */
+  pll_second ();
+  sample_align (pll_boundary);
 
-static void ti_S7 ()
-{
-  ti_STATE(8);
+  ti_STATE(1);
+  timerint0_at (pll_boundary + TI_DECIDE);
 }
 
 
-static void ti_S8 ()
+/* Abstand der LO-Summe von der Entscheidungsschwelle in Prozent */
+static uint8_t window_conf (uint8_t low, uint8_t n)
 {
-  bit_count[1] = SIGNAL_STATE();
-  ti_STATE(9);
-}
-
+  const int16_t d = 2 * low - n;
 
-static void ti_S9 ()
-{
-  bit_count[1] += SIGNAL_STATE();
-  ti_STATE(10);
+  return (d < 0 ? -d : d) * 100 / n;
 }
 
 
-static void ti_S10 ()
+static void ti_S1 ()
 {
-  bit_count[1] += SIGNAL_STATE();
-  ti_STATE(11);
-}
+  const uint8_t na = SAMPLE_A1 - SAMPLE_A0, nb = SAMPLE_B1 - SAMPLE_B0;
 
+  ti_STATE(0);
+  timerint0_at (pll_boundary + TIMER1VALUE_1S + TI_LAG);
 
-static void ti_S11 ()
-{
-  bit_state |= bit_count[1] <= 1 ? 0b00 : 0b01;
-  protocol ();
-  if (sec == 0)
+  if (!sample_ready)
   {
-    if (valid_time_info)
-    {
-      update_time_info ();
-    }
-    else
-    {
-      inc_min = true;
-    };
-    valid_time_info = false;
+    /* Fenster nicht vollstaendig abgetastet */
+    trace_put (TR_BIT, 0xFF, sec << 8, timer1_get ());
+    return;
   };
-  ti_STATE(12);
-}
+  sample_ready = false;
+  bit_count[0] = sample_low[0];
+  bit_count[1] = sample_low[1];
+  bit_state = (2 * bit_count[0] > na ? 0b00 : 0b10) | (2 * bit_count[1] > nb ? 0b00 : 0b01);
 
+  const uint8_t ca = window_conf (bit_count[0], na), cb = window_conf (bit_count[1], nb);
+  bit_conf = ca < cb ? ca : cb;
+  trace_put (TR_BIT, bit_state, sec << 8 | bit_conf, timer1_get ());
 
-static void ti_S12 ()
-{
-#define TI_LASTSTATE()  (1000000/TIMER0USECS-1)
-  if (ti_state >= TI_LASTSTATE())
+  /* dekodiert wird in der Hintergrundaktion */
+  if (b_full (&bit_events))
   {
-    ti_STATE(0);
+    b_set_overrun (&bit_events);
   }
   else
   {
-    ++ti_state;
+    b_put (&bit_events, (struct BitEvent) { .sec = sec, .bits = bit_state, .conf = bit_conf, .t1 = pll_boundary });
   }
 }
 
 
-/*******************************
- * Flanken-Interrupt Bit Start *
- *******************************/
+/***************************
+ * Input-Capture Bit Start *
+ ***************************/
 
 static void ei_S0 (void);
 static void ei_S1 (void);
@@ -836,24 +591,28 @@ static void ei_S3 (void);
   do                                    \
   {                                     \
     ei_state = n;                       \
-    interrupt0_callback = XCAT(ei_S,n); \
+    timer1_capture_callback = XCAT(ei_S,n); \
   }                                     \
   while (false);
 
 
 static inline bool valid_edge (void)
 {
-  (last_tcnt1 = TCNT1), TCNT1 = 0;
+  last_tcnt1 = timer1_capture - edge_t1;
+  edge_t1 = timer1_capture;
 
   const bool ok_1s = 1*15*(TIMER1VALUE_1S/16) <= last_tcnt1 && last_tcnt1 <= 1*17*(TIMER1VALUE_1S/16);
   const bool ok_2s = 2*15*(TIMER1VALUE_1S/16) <= last_tcnt1 && last_tcnt1 <= 2*17*(TIMER1VALUE_1S/16);
+  const uint32_t b = last_tcnt1 / 32;
+  trace_put (TR_EDGE, (ok_1s || ok_2s) << 7 | ei_state, b > UINT16_MAX ? UINT16_MAX : b, edge_t1);
   return ok_1s || ok_2s;
 }
 
 
 static void ei_S0 (void)
 {
-  TCNT1 = 0;
+  edge_t1 = timer1_capture;
+  trace_put (TR_EDGE, ei_state, 0, edge_t1);
   ei_STATE(1);
 }
 
@@ -888,10 +647,18 @@ static void ei_S3 (void)
 {
   if (valid_edge ())
   {
-    (last_tcnt0 = TCNT0), (TCNT0 = TIMER0CMPVALUE/2);
+    last_tcnt0 = hal_get_tcnt0 ();
     last_ti_state = ti_state;
-    pll_synced = true;
-    ti_STATE(0);
+
+    /* die PLL liefert die Weckzeiten, nur beim Einrasten Timer 0 neu aufsetzen */
+    if (!pll_synced || !pll_edge (edge_t1))
+    {
+      /* Sekundenbeginn kurz nach der gelatchten Flanke */
+      pll_acquire (edge_t1);
+      pll_synced = true;
+      ti_STATE(0);
+      timerint0_restart (edge_t1 + TI_LAG);
+    }
   }
   else
   {
@@ -960,10 +727,11 @@ static int8_t last_bit (int8_t argc, char **argv)
 {
   do
   {
-    uart_printf_P (PSTR("%2.2u c=%1.1u/%1.1u s=%1.1u%1.1u\r"),
+    uart_printf_P (PSTR("%2.2u c=%2.2u/%2.2u s=%1.1u%1.1u q=%3.3u%%\r"),
                    sec,
                    bit_count[0], bit_count[1],
-                   !!(bit_state & 0b10), !!(bit_state & 0b01));
+                   !!(bit_state & 0b10), !!(bit_state & 0b01),
+                   bit_conf);
   }
   while (cont (argc, argv));
   return 0;
@@ -985,7 +753,7 @@ static int8_t last_timer (int8_t argc, char **argv)
 {
   do
   {
-    uart_printf_P (PSTR("last_tcnt0=%05.5u last_tcnt1=%05.5u\r"),
+    uart_printf_P (PSTR("last_tcnt0=%05.5u last_tcnt1=%07.7lu\r"),
                    last_tcnt0, last_tcnt1);
   }
   while (cont (argc, argv));
@@ -1021,15 +789,25 @@ static int8_t last_time_string (int8_t argc, char **argv)
   {
     do
     {
-      char temp_time_string[80], *p;
-
-      strlcpy (temp_time_string, time_string, sizeof temp_time_string);
-      while ((p = strpbrk (temp_time_string, STX ETX CR LF)))
+      if (telegram_binary ())
       {
-        *p = '~';
-      };
+        for (uint8_t i = 0; i < telegram_len; ++i)
+        {
+          uart_printf_P (PSTR("%02x"), (uint8_t) time_string[i]);
+        }
+      }
+      else
+      {
+        char temp_time_string[80], *p;
 
-      uart_puts (temp_time_string);
+        strlcpy (temp_time_string, time_string, sizeof temp_time_string);
+        while ((p = strpbrk (temp_time_string, STX ETX CR LF)))
+        {
+          *p = '~';
+        };
+
+        uart_puts (temp_time_string);
+      };
       uart_putc ('\r');
     }
     while (cont (argc, argv));
@@ -1059,6 +837,17 @@ static void uart_prompt (void)
  *****************************/
 
 static int8_t istat (int8_t argc, char **argv);
+static int8_t idle (int8_t argc, char **argv);
+static int8_t mem (int8_t argc, char **argv);
+static int8_t profile (int8_t argc, char **argv);
+static int8_t trace_cmd (int8_t argc, char **argv);
+static int8_t capture (int8_t argc, char **argv);
+static int8_t bench (int8_t argc, char **argv);
+static int8_t emit (int8_t argc, char **argv);
+static int8_t pll (int8_t argc, char **argv);
+static int8_t pps (int8_t argc, char **argv);
+static int8_t format (int8_t argc, char **argv);
+static int8_t vote (int8_t argc, char **argv);
 static int8_t switches (int8_t argc, char **argv);
 static int8_t reset (int8_t argc, char **argv);
 static int8_t help (int8_t argc, char **argv);
@@ -1079,7 +868,18 @@ static const __flash struct CMD
   { .name = FSTR("timer"),       .func = last_timer      },
   { .name = FSTR("time"),        .func = last_time_info  },
   { .name = FSTR("ts"),          .func = last_time_string},
+  { .name = FSTR("format"),      .func = format          },
   { .name = FSTR("istat"),       .func = istat           },
+  { .name = FSTR("idle"),        .func = idle            },
+  { .name = FSTR("mem"),         .func = mem             },
+  { .name = FSTR("profile"),     .func = profile         },
+  { .name = FSTR("trace"),       .func = trace_cmd       },
+  { .name = FSTR("capture"),     .func = capture         },
+  { .name = FSTR("bench"),       .func = bench           },
+  { .name = FSTR("emit"),        .func = emit            },
+  { .name = FSTR("pll"),         .func = pll             },
+  { .name = FSTR("pps"),         .func = pps             },
+  { .name = FSTR("vote"),        .func = vote            },
   { .name = FSTR("switches"),    .func = switches        },
   { .name = FSTR("reset"),       .func = reset           },
   { .name = FSTR("?"),           .func = help            },
@@ -1090,24 +890,269 @@ static const __flash struct CMD
 /* Interruptstatistik */
 static int8_t istat (int8_t argc, char **argv)
 {
-  uart_printf_P (PSTR("up=%luµs bad=%lu\r\n"), microsecs, badcount);
-  uart_printf_P (PSTR("bad_rxc=%lu\r\n"), badcount_rxc);
-  uart_printf_P (PSTR("bad_udre=%lu\r\n"), badcount_udre);
+  const int64_t up = now ();
+  uart_printf_P (PSTR("up=%lu.%06lus bad=%lu\r\n"),
+                 (unsigned long) (up / 1000000), (unsigned long) (up % 1000000), badcount);
+  uart_printf_P (PSTR("rxc=%lu fe=%lu dor=%lu pe=%lu overrun=%lu\r\n"),
+                 uart_count_rxc, uart_count_fe, uart_count_dor, uart_count_pe, uart_count_overrun);
   uart_printf_P (PSTR("bad_txc=%lu\r\n"), badcount_txc);
-  uart_printf_P (PSTR("bad_timer2_comp=%lu\r\n"), badcount_timer2_comp);
   uart_printf_P (PSTR("bad_timer2_ovf=%lu\r\n"), badcount_timer2_ovf);
-  uart_printf_P (PSTR("bad_timer1_capt=%lu\r\n"), badcount_timer1_capt);
-  uart_printf_P (PSTR("bad_timer1_compa=%lu\r\n"), badcount_timer1_compa);
-  uart_printf_P (PSTR("bad_timer1_compb=%lu\r\n"), badcount_timer1_compb);
-  uart_printf_P (PSTR("bad_timer1_ovf=%lu\r\n"), badcount_timer1_ovf);
   uart_printf_P (PSTR("bad_timer0_ovf=%lu\r\n"), badcount_timer0_ovf);
-  uart_printf_P (PSTR("int0=%lu\r\n"), count_int0);
+  uart_printf_P (PSTR("capt=%lu\r\n"), count_capt);
   uart_printf_P (PSTR("bad_int1=%lu\r\n"), badcount_int1);
   uart_printf_P (PSTR("bad_int2=%lu"), badcount_int2);
   return 0;
 }
 
 
+/* Weckrufe und Wachanteil: letzte Sekunde, Mittel und wachste Sekunde seit dem letzten Aufruf */
+static int8_t idle (int8_t argc, char **argv)
+{
+  cli ();
+  const struct PowerSecond last = power_last, worst = power_worst;
+  const uint32_t secs = power_secs, wakes = power_wakes;
+  const uint64_t awake = power_awake, span = power_span;
+  sei ();
+  power_clear_stat ();
+
+  const uint16_t duty = span ? awake * 10000 / span : 0;
+  uart_printf_P (PSTR("last: wakes=%u duty=%u.%02u%%\r\n"),
+                 last.wakes, last.duty / 100, last.duty % 100);
+  uart_printf_P (PSTR("%lus: wakes=%lu/s duty=%u.%02u%% worst=%u.%02u%%"),
+                 secs, secs ? wakes / secs : 0, duty / 100, duty % 100,
+                 worst.duty / 100, worst.duty % 100);
+  return 0;
+}
+
+
+/* SRAM-Belegung, Stack seit Reset und die groessten statischen Puffer */
+static int8_t mem (int8_t argc, char **argv)
+{
+  struct HalMem m;
+
+  hal_mem (&m);
+  uart_printf_P (PSTR("data=%u bss=%u noinit=%u free=%u\r\n"), m.data, m.bss, m.noinit, m.free);
+  uart_printf_P (PSTR("stack=%u max=%u unused=%u\r\n"), m.stack, m.free - m.unused, m.unused);
+  uart_printf_P (PSTR("uart=%u cmdint=%u telegram=%u vote=%u prof=%u trace=%u capture=%u bits=%u time=%u"),
+                 uart_ram, CMDINT_LINE, telegram_ram, vote_ram, prof_ram, (uint16_t) sizeof trace_ring, capture_ram,
+                 (uint16_t) sizeof bit_events, (uint16_t) (sizeof time_info + sizeof cached_time_info));
+  return 0;
+}
+
+
+static void print_prof_stat (const __flash char *what, const struct ProfStat *s)
+{
+  uart_puts_P (PSTR("  "));
+  uart_puts_P (what);
+  uart_printf_P (PSTR(" n=%lu min=%u avg=%lu max=%u:"),
+                 s->n, s->min, s->n ? s->sum / s->n : 0, s->max);
+  for (uint8_t i = 0; i < PROF_BINS; ++i)
+  {
+    uart_printf_P (PSTR(" %u"), s->hist[i]);
+  };
+  uart_crlf ();
+}
+
+
+/* Laufzeit und Latenz je Interrupt in Takten seit dem letzten Aufruf, Klassen <32 <64 .. <2048 >=2048 */
+static int8_t profile (int8_t argc, char **argv)
+{
+  for (uint8_t v = 0; v < PROF_VECTORS; ++v)
+  {
+    struct ProfStat run, latency;
+
+    prof_take (v, &run, &latency);
+    uart_putsln_P (prof_vectors[v].name);
+    print_prof_stat (PSTR("run"), &run);
+    if (v < PROF_LATENCY)
+    {
+      print_prof_stat (PSTR("lat"), &latency);
+    }
+  };
+  uart_printf_P (PSTR("bins <%u .. <%u >=%u"),
+                 PROF_BIN0, PROF_BIN0 << (PROF_BINS - 2), PROF_BIN0 << (PROF_BINS - 2));
+  return 0;
+}
+
+
+/* Ereignisring binaer ausgeben (host/dcf77trace) und neu starten */
+static int8_t trace_cmd (int8_t argc, char **argv)
+{
+  trace_dump ();
+  return 0;
+}
+
+
+/* Flanken an PD2 binaer streamen (host/dcf77cap), bis eine Taste kommt */
+static int8_t capture (int8_t argc, char **argv)
+{
+  capture_start ();
+  while (uart_getc_nowait () == -1)
+  {
+    sleep ();
+    capture_flush ();
+  };
+  capture_stop ();
+  return 0;
+}
+
+
+/* Takte fuer das Zeittelegramm */
+static uint16_t bench_telegram (bool full)
+{
+  cli ();
+  const uint16_t tcnt1 = hal_cycles_start ();
+  if (full)
+  {
+    telegram_render (&cached_time_info, sec, quartz_time);
+  }
+  else
+  {
+    telegram_set_sec (sec);
+  };
+  const uint16_t cycles = hal_cycles_stop (tcnt1);
+  sei ();
+  return cycles;
+}
+
+
+static int8_t bench (int8_t argc, char **argv)
+{
+  if (valid_time_info_once)
+  {
+    cli ();
+    const uint16_t overhead = hal_cycles_stop (hal_cycles_start ());
+    sei ();
+    const uint16_t full = bench_telegram (true), part = bench_telegram (false);
+
+    /* die Messung selbst kann laenger dauern als der gemessene Code */
+    uart_printf_P (PSTR("telegram full=%u sec=%u cycles"),
+                   full > overhead ? full - overhead : 0,
+                   part > overhead ? part - overhead : 0);
+  };
+  return 0;
+}
+
+
+/* Sendezeitpunkt des Zeittelegramms */
+static int8_t emit (int8_t argc, char **argv)
+{
+  if (argc > 1)
+  {
+    if (!emit_set_offset (atol (argv[1])))
+    {
+      return -1;
+    };
+    emit_store ();
+  }
+  else
+  {
+    cli ();
+    const long count = emit_count, late = emit_late;
+    const int32_t min = emit_min, max = emit_max;
+    const int64_t sum = emit_sum;
+    sei ();
+    uart_printf_P (PSTR("offset=%ldµs n=%lu late=%lu min=%ldµs avg=%ldµs max=%ldµs"),
+                   (long) emit_offset, count, late,
+                   (long) T1_TO_US(min), (long) T1_TO_US(count ? (int32_t) (sum / count) : 0), (long) T1_TO_US(max));
+  };
+  emit_clear_stat ();
+  return 0;
+}
+
+
+/* Zustand der Sekunden-PLL */
+static int8_t pll (int8_t argc, char **argv)
+{
+  do
+  {
+    cli ();
+    const uint8_t state = pll_state, stage = pll_stage;
+    const int32_t phase = pll_phase, freq = pll_freq;
+    const long outliers = pll_outliers;
+    const uint32_t ho_secs = pll_holdover_secs;
+    const int32_t ho_err = pll_holdover_err;
+    sei ();
+
+    uart_puts_P (pll_states[state].name);
+    uart_printf_P (PSTR(" stage=%u phase=%ldµs freq=%ldppb outliers=%lu holdover=%lus/%ldµs\r"),
+                   stage, (long) T1_TO_US(phase),
+                   (long) ((int64_t) freq * 1000000000 / ((int64_t) TIMER1VALUE_1S << 16)),
+                   outliers, (long) ho_secs, (long) T1_TO_US(ho_err));
+  }
+  while (cont (argc, argv));
+  return 0;
+}
+
+
+/* Format des Zeittelegramms */
+static int8_t format (int8_t argc, char **argv)
+{
+  if (argc > 1)
+  {
+    uint8_t f = 1;
+
+    while (telegram_name (f) && strcmp_P (argv[1], telegram_name (f)) != 0)
+    {
+      ++f;
+    };
+    if (!telegram_select (f))
+    {
+      return -1;
+    };
+    telegram_store ();
+  }
+  else
+  {
+    for (uint8_t f = 1; telegram_name (f); ++f)
+    {
+      uart_putc (f == telegram_format ? '*' : ' ');
+      uart_puts_P (telegram_name (f));
+    }
+  };
+  return 0;
+}
+
+
+/* Sekundenimpuls an OC1B */
+static int8_t pps (int8_t argc, char **argv)
+{
+  do
+  {
+    cli ();
+    const bool enabled = pps_enabled ();
+    const long count = pps_count;
+    const uint32_t idle = pll_idle;
+    sei ();
+
+    uart_printf_P (PSTR("on=%u n=%lu idle=%lus\r"), enabled, count, (long) idle);
+  }
+  while (cont (argc, argv));
+  return 0;
+}
+
+
+/* Plausibilitaetspruefung der Minuten */
+static int8_t vote (int8_t argc, char **argv)
+{
+  if (argc > 1)
+  {
+    if (!vote_set_frames (atoi (argv[1])))
+    {
+      return -1;
+    };
+    vote_store ();
+  }
+  else
+  {
+    uart_printf_P (PSTR("frames=%u accepted=%lu range=%lu disagree=%lu"),
+                   vote_frames, vote_accepted, vote_range, vote_disagree);
+  };
+  vote_clear_stat ();
+  return 0;
+}
+
+
 /* DIP-Switches */
 static int8_t switches (int8_t argc, char **argv)
 {
@@ -1176,36 +1221,25 @@ static int8_t interp (int8_t argc, char **argv)
  *******************/
 
 
-uint8_t mcusr_mirror __attribute__ ((section (".noinit")));
-
-
-void get_mcusr(void) \
-  __attribute__((naked)) \
-  __attribute__((section(".init3")));
-
-void get_mcusr(void)
-{
-  mcusr_mirror = MCUSR;
-  MCUSR = 0;
-  wdt_disable();
-}
-
-
 static void init (void)
 {
   cli ();
 
-  /* Eingaenge DIP-Switches */
-  DDR_SWITCHES  &= ~MASK_SWITCHES;
-  PORT_SWITCHES |=  MASK_SWITCHES;
-
-  /* Ausgang PDN */
-  DDR_PDN  |=  MASK_PDN;
-  PORT_PDN |=  MASK_PDN;
+  /* DIP-Switches, PDN */
+  hal_init ();
 
   uart_init ();
-  interrupt0_init ();
   timer_init ();
+  telegram_init ();
+  timer1_init ();
+
+  emit_init ();
+  pll_init ();
+  pps_init ();
+  sample_init ();
+  vote_init ();
+  power_init ();
+  uart_hold (sw_no_debug ());
 
   sleep_background_action = background;
   uart_sleep = sleep;
@@ -1255,7 +1289,7 @@ int main (void)
   init ();
   signon_message ();
 
-  PORT_PDN &= ~MASK_PDN;
+  hal_pdn (false);
 
   while (sw_no_debug ())
   {
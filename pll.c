@@ -0,0 +1,181 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+
+#include "common.h"
+#include "timer1.h"
+#include "pll.h"
+
+
+/*
+ * Software-PLL fuer die Sekundenmarke.  pll_boundary ist der
+ * Timer-1-Zeitstempel der laufenden Sekunde und wird jede Sekunde um
+ * die gelernte Periode TIMER1VALUE_1S + pll_freq/65536 weitergestellt.
+ * Jede gueltige Flanke liefert den Phasenfehler pll_phase; ein
+ * PI-Regler korrigiert damit Phase und Frequenz, die Verstaerkung sinkt
+ * stufenweise, solange die Flanken im Fangbereich bleiben.  Ohne
+ * Flanken laeuft die Sekundenmarke mit der gelernten Frequenz weiter.
+ * Die Weckzeiten von Timer 0 rechnet main.c von pll_boundary aus.
+ */
+
+
+/* Fangbereich, darueber hinaus Flanken verwerfen */
+#define PLL_CAPTURE     US_TO_T1(40000)
+
+/* so oft hintereinander groesserer Phasenfehler: eine Stufe zurueck */
+#define PLL_LOCK        US_TO_T1(20000)
+#define PLL_UNLOCK      3
+
+/* so viele Flanken ausserhalb des Fangbereichs, dann neu einrasten */
+#define PLL_OUTLIERS    8
+
+/*
+ * Stufen der Schleifenverstaerkung, je PLL_STAGE_EDGES Flanken:
+ * Kp = 2^-(3+s), Ki = 2^-(8+2s), kritisch gedaempft
+ */
+#define PLL_STAGES      5
+#define PLL_STAGE_EDGES 64
+#define PLL_KP(s)       (3 + (s))
+#define PLL_KI(s)       (8 + 2 * (s))
+
+/* Sekunden ohne Flanke bis Holdover */
+#define PLL_IDLE_SECS   10
+
+/* gelernte Frequenz hoechstens stuendlich ins EEPROM */
+#define PLL_STORE_SECS  3600
+
+/* ±200 ppm */
+#define PLL_FREQ_MAX    ((int32_t) (TIMER1VALUE_1S / 5000) << 16)
+
+
+static uint32_t ee_pll_freq EEMEM = UINT32_MAX;
+
+volatile uint32_t pll_boundary;
+uint8_t pll_state, pll_stage;
+int32_t pll_phase, pll_freq;
+long pll_outliers;
+uint32_t pll_holdover_secs, pll_idle;
+int32_t pll_holdover_err;
+volatile bool pll_store_due;
+
+static uint16_t pll_frac;
+static uint8_t pll_good, pll_far, pll_bad;
+static uint16_t pll_store_secs;
+
+
+static int32_t clamp_freq (int32_t freq)
+{
+  return freq > PLL_FREQ_MAX ? PLL_FREQ_MAX : freq < -PLL_FREQ_MAX ? -PLL_FREQ_MAX : freq;
+}
+
+
+void pll_store (void)
+{
+  cli ();
+  const int32_t freq = pll_freq;
+  sei ();
+  eeprom_update_dword (&ee_pll_freq, freq);
+}
+
+
+void pll_init (void)
+{
+  const uint32_t ee = eeprom_read_dword (&ee_pll_freq);
+
+  pll_freq = ee == UINT32_MAX ? 0 : clamp_freq ((int32_t) ee);
+  pll_state = PLL_UNLOCKED;
+}
+
+
+/* Sekundenmarke hart auf die Flanke setzen, die gelernte Frequenz bleibt */
+void pll_acquire (uint32_t edge)
+{
+  pll_boundary = edge - TIMER1VALUE_1S - (pll_freq >> 16);
+  pll_frac = 0;
+  pll_phase = 0;
+  pll_stage = 0;
+  pll_good = pll_far = pll_bad = 0;
+  pll_idle = 0;
+  pll_state = PLL_ACQUIRE;
+}
+
+
+/* false: zu viele Flanken ausserhalb des Fangbereichs */
+bool pll_edge (uint32_t edge)
+{
+  int32_t pe = edge - pll_boundary;
+
+  /* Flanke vor dem Sekundeninterrupt gehoert zur naechsten Marke */
+  if (pe > (int32_t) TIMER1VALUE_1S / 2)
+  {
+    pe -= TIMER1VALUE_1S + (pll_freq >> 16);
+  };
+
+  if (pe < -PLL_CAPTURE || pe > PLL_CAPTURE)
+  {
+    ++pll_outliers;
+    return ++pll_bad < PLL_OUTLIERS;
+  };
+  pll_bad = 0;
+
+  if (pll_state == PLL_HOLDOVER)
+  {
+    pll_holdover_secs = pll_idle;
+    pll_holdover_err = pe;
+  };
+  pll_idle = 0;
+  pll_phase = pe;
+
+  pll_boundary += pe >> PLL_KP(pll_stage);
+  pll_freq = clamp_freq (pll_freq + pe * (1L << (16 - PLL_KI(pll_stage))));
+
+  if (-PLL_LOCK <= pe && pe <= PLL_LOCK)
+  {
+    pll_far = 0;
+    if (++pll_good >= PLL_STAGE_EDGES && pll_stage < PLL_STAGES - 1)
+    {
+      pll_good = 0;
+      if (++pll_stage == PLL_STAGES - 1)
+      {
+        pll_store_secs = PLL_STORE_SECS;
+      }
+    }
+  }
+  else if (++pll_far >= PLL_UNLOCK)
+  {
+    pll_good = pll_far = 0;
+    if (pll_stage > 0)
+    {
+      --pll_stage;
+    }
+  };
+  pll_state = pll_stage > 0 ? PLL_LOCKED : PLL_ACQUIRE;
+  return true;
+}
+
+
+/* aus dem Weckruf von Timer 0 kurz nach der Sekundenmarke */
+void pll_second (void)
+{
+  const int32_t acc = (int32_t) pll_frac + pll_freq;
+
+  pll_boundary += TIMER1VALUE_1S + (acc >> 16);
+  pll_frac = acc & 0xFFFF;
+
+  if (++pll_idle > PLL_IDLE_SECS && pll_state == PLL_LOCKED)
+  {
+    pll_state = PLL_HOLDOVER;
+  };
+
+  if (pll_state == PLL_LOCKED && pll_stage == PLL_STAGES - 1 && ++pll_store_secs >= PLL_STORE_SECS)
+  {
+    pll_store_secs = 0;
+    pll_store_due = true;
+  }
+}
@@ -0,0 +1,38 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _PLL_H
+#define _PLL_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+enum PllState
+{
+  PLL_UNLOCKED = 0,
+  PLL_ACQUIRE,
+  PLL_LOCKED,
+  PLL_HOLDOVER,
+};
+
+
+extern volatile uint32_t pll_boundary;
+extern uint8_t pll_state, pll_stage;
+extern int32_t pll_phase, pll_freq;
+extern long pll_outliers;
+extern uint32_t pll_holdover_secs, pll_idle;
+extern int32_t pll_holdover_err;
+extern volatile bool pll_store_due;
+
+extern void pll_init (void);
+extern void pll_store (void);
+extern void pll_acquire (uint32_t edge);
+extern bool pll_edge (uint32_t edge);
+extern void pll_second (void);
+
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "hal.h"
+#include "timer1.h"
+#include "power.h"
+
+
+/*
+ * Schlafen und Wachzeit.  Ausser Idle halten alle Schlafmodi des
+ * ATmega32 clkI/O an (ADC Noise Reduction, Power-down, Power-save,
+ * Standby).  Damit stuenden Timer 1, der als Zeitbasis und fuer das
+ * Input Capture durchlaufen muss, Timer 0 und der UART; Timer 2 liefe
+ * in Power-save nur mit einem Uhrenquarz an TOSC.  Idle ist deshalb
+ * der tiefste brauchbare Modus.  Gespart wird an den Weckrufen und an
+ * den Taktquellen: Timer 2 bekommt nur in den Abtastfenstern Takt,
+ * Analogkomparator und ADC sind aus.
+ *
+ * Gemessen wird in Timer-1-Takten, wie lange die CPU schlaeft, der
+ * weckende Interrupt zaehlt dabei zum Schlaf.  Nach jeder vollen
+ * Sekunde stehen Weckrufe und Wachanteil in power_last, die wachste
+ * Sekunde in power_worst und die Summen in power_secs .. power_span.
+ */
+
+
+struct PowerSecond power_last, power_worst;
+uint32_t power_secs, power_wakes;
+uint64_t power_awake, power_span;
+
+static uint32_t sec_start, sec_slept;
+static uint16_t sec_wakes;
+
+
+void power_clear_stat (void)
+{
+  cli ();
+  power_worst.wakes = power_worst.duty = 0;
+  power_secs = power_wakes = 0;
+  power_awake = power_span = 0;
+  sei ();
+}
+
+
+/* Sekunde abschliessen, span in Timer-1-Takten, bei freigegebenen Interrupts */
+static void power_second (uint16_t wakes, uint32_t slept, uint32_t span)
+{
+  const uint32_t awake = span > slept ? span - slept : 0;
+
+  power_last.wakes = (uint64_t) wakes * TIMER1VALUE_1S / span;
+  power_last.duty = (uint64_t) awake * 10000 / span;
+  if (power_last.duty > power_worst.duty)
+  {
+    power_worst = power_last;
+  };
+
+  ++power_secs;
+  power_wakes += wakes;
+  power_awake += awake;
+  power_span += span;
+}
+
+
+/* Timer 1 laeuft spaetestens alle 125 ms ueber, 16 Bit reichen fuer den Schlaf */
+void power_sleep (void)
+{
+  cli ();
+  const uint16_t t = hal_get_tcnt1 ();
+  hal_sleep ();
+  cli ();
+  const uint32_t now = timer1_get ();
+  ++sec_wakes;
+  sec_slept += (uint16_t) ((uint16_t) now - t);
+
+  /* unter der Sperre nur die Zaehler abholen, die Divisionen halten sonst jede ISR auf */
+  const uint32_t span = now - sec_start;
+  if (span < TIMER1VALUE_1S)
+  {
+    sei ();
+    return;
+  };
+  const uint16_t wakes = sec_wakes;
+  const uint32_t slept = sec_slept;
+  sec_wakes = 0;
+  sec_slept = 0;
+  sec_start = now;
+  sei ();
+
+  power_second (wakes, slept, span);
+}
+
+
+void power_init (void)
+{
+  hal_power_init ();
+  sec_start = timer1_get ();
+}
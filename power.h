@@ -0,0 +1,30 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _POWER_H
+#define _POWER_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Wachanteil in 0,01 % */
+struct PowerSecond
+{
+  uint16_t wakes, duty;
+};
+
+
+extern struct PowerSecond power_last, power_worst;
+extern uint32_t power_secs, power_wakes;
+extern uint64_t power_awake, power_span;
+
+extern void power_init (void);
+extern void power_sleep (void);
+extern void power_clear_stat (void);
+
+
+#endif
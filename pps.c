@@ -0,0 +1,149 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "hal.h"
+#include "timer1.h"
+#include "pll.h"
+#include "prof.h"
+#include "pps.h"
+
+
+/*
+ * Sekundenimpuls an OC1B/PD4 fuer den PPS-Eingang des Hosts.  Die
+ * Flanken schaltet Timer 1 Compare B selbst, der Interrupt stellt nur
+ * den naechsten Vergleich ein.  Er weckt dreimal je Sekunde: einen
+ * halben Umlauf von Timer 1 vor der Sekundenmarke (Marke neu von der
+ * PLL holen, auf "setzen" umschalten), beim Setzen (auf "loeschen"
+ * nach PPS_WIDTH) und beim Loeschen (naechste Marke vormerken).
+ *
+ * Der Impuls kommt nur, solange die PLL eingerastet ist oder der
+ * geschaetzte Fehler im Holdover unter PPS_MAX_ERR bleibt.  Sonst
+ * weckt der Interrupt nur einmal je Sekunde vor der Marke.
+ */
+
+
+#define PPS_WIDTH       US_TO_T1(100000)
+
+/* Mindestabstand zum Vergleichszeitpunkt beim Umschalten */
+#define PPS_MARGIN      US_TO_T1(100)
+
+/* so lange vor der Marke umschalten, weniger als ein Umlauf von Timer 1 */
+#define PPS_PREPARE     0x8000
+
+/* angenommene Restabweichung im Holdover und tolerierter Fehler */
+#define PPS_HOLDOVER_PPB 1000
+#define PPS_MAX_ERR     1000    /* µs */
+
+#define PPS_HOLDOVER_SECS ((uint32_t) PPS_MAX_ERR * 1000 / PPS_HOLDOVER_PPB)
+
+
+enum
+{
+  PPS_IDLE,
+  PPS_ARMED,
+  PPS_HIGH,
+};
+
+
+long pps_count;
+
+static uint8_t pps_state;
+static uint32_t pps_edge, pps_wake;
+
+
+bool pps_enabled (void)
+{
+  return pll_state == PLL_LOCKED
+         ||
+         (pll_state == PLL_HOLDOVER && pll_idle <= PPS_HOLDOVER_SECS);
+}
+
+
+/*********************
+ * Timer-1-Compare-B *
+ *********************/
+
+static void wake (uint32_t at)
+{
+  pps_wake = at;
+  timer1_compare (T1_COMPARE_B, at);
+}
+
+
+static inline void compare_b (void)
+{
+  const uint32_t t = timer1_get ();
+
+  /* hoechstens ein frueher Match im Umlauf vor dem Zeitpunkt (timer1.c) */
+  if ((int32_t) (t - pps_wake) < 0)
+  {
+    return;
+  };
+
+  switch (pps_state)
+  {
+    case PPS_ARMED:
+      /* gerade gesetzt */
+      hal_pps_set_on_match (false);
+      wake (pps_edge + PPS_WIDTH);
+      pps_state = PPS_HIGH;
+      ++pps_count;
+      return;
+
+    case PPS_HIGH:
+      /* gerade geloescht */
+      pps_state = PPS_IDLE;
+      break;
+  };
+
+  /* naechste Sekundenmarke nach der aktuellen Schaetzung der PLL */
+  uint32_t edge = pll_boundary;
+  while ((int32_t) (edge - t) <= PPS_MARGIN)
+  {
+    edge += TIMER1VALUE_1S + (pll_freq >> 16);
+  };
+  pps_edge = edge;
+
+  if (edge - t > PPS_PREPARE)
+  {
+    wake (edge - PPS_PREPARE);
+  }
+  else if (pps_enabled ())
+  {
+    hal_pps_set_on_match (true);
+    wake (edge);
+    pps_state = PPS_ARMED;
+  }
+  else
+  {
+    /* diese Marke auslassen, vor der naechsten wieder nachsehen */
+    wake (edge + TIMER1VALUE_1S - PPS_PREPARE);
+  }
+}
+
+
+ISR (TIMER1_COMPB_vect)
+{
+  const uint16_t latency = hal_latency_compb ();
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  compare_b ();
+
+  prof_isr (PROF_TIMER1_COMPB, tcnt1, latency);
+}
+
+
+/* bei gesperrten Interrupts, nach timer_init() */
+void pps_init (void)
+{
+  pps_state = PPS_IDLE;
+  hal_pps_init ();
+  wake (timer1_get () + PPS_PREPARE);
+}
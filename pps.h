@@ -0,0 +1,20 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _PPS_H
+#define _PPS_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+extern long pps_count;
+
+extern bool pps_enabled (void);
+extern void pps_init (void);
+
+
+#endif
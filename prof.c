@@ -0,0 +1,84 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "hal.h"
+#include "prof.h"
+
+
+/*
+ * Laufzeit und Eintrittslatenz der Interrupts in CPU-Takten, beides
+ * ueber Timer 1 und damit auf TIMER1PRESCALE Takte genau.  Die
+ * Laufzeit zaehlt ab der ersten Anweisung der ISR bis prof_isr(),
+ * Prolog und Epilog fehlen.  Die Latenz reicht vom Compare-Match,
+ * Capture oder Ueberlauf bis zur ersten Anweisung (hal_latency_*()).
+ * prof_isr() laeuft im Interrupt und braucht deshalb keine Sperre; die
+ * Summen reichen fuer einige Stunden zwischen zwei Abfragen.
+ */
+
+
+static struct ProfStat prof_run[PROF_VECTORS], prof_latency[PROF_LATENCY];
+
+const __flash uint16_t prof_ram = sizeof prof_run + sizeof prof_latency;
+
+
+static void record (struct ProfStat *s, uint16_t cycles)
+{
+  if (s->n == 0 || cycles < s->min)
+  {
+    s->min = cycles;
+  };
+  if (cycles > s->max)
+  {
+    s->max = cycles;
+  };
+  s->sum += cycles;
+  ++s->n;
+
+  uint8_t bin = 0;
+  for (uint16_t c = cycles / PROF_BIN0; c && bin < PROF_BINS - 1; c >>= 1)
+  {
+    ++bin;
+  };
+  if (s->hist[bin] < UINT16_MAX)
+  {
+    ++s->hist[bin];
+  }
+}
+
+
+/* am Ende der ISR: tcnt1 von timer1_isr_start() am Anfang, Latenz von hal_latency_*() */
+void prof_isr (uint8_t vector, uint16_t tcnt1, uint16_t latency)
+{
+  record (&prof_run[vector], hal_cycles_stop (tcnt1));
+  if (vector < PROF_LATENCY)
+  {
+    record (&prof_latency[vector], latency);
+  }
+}
+
+
+/* Statistik eines Interrupts abholen und zuruecksetzen */
+void prof_take (uint8_t vector, struct ProfStat *run, struct ProfStat *latency)
+{
+  cli ();
+  *run = prof_run[vector];
+  memset (&prof_run[vector], 0, sizeof prof_run[vector]);
+  if (vector < PROF_LATENCY)
+  {
+    *latency = prof_latency[vector];
+    memset (&prof_latency[vector], 0, sizeof prof_latency[vector]);
+  }
+  else
+  {
+    memset (latency, 0, sizeof *latency);
+  };
+  sei ();
+}
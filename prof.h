@@ -0,0 +1,49 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _PROF_H
+#define _PROF_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Interrupts mit bekanntem Ereigniszeitpunkt zuerst, nur fuer sie gibt es eine Latenz */
+enum ProfVector
+{
+  PROF_TIMER0_COMP = 0,
+  PROF_TIMER2_COMP,
+  PROF_TIMER1_CAPT,
+  PROF_TIMER1_COMPA,
+  PROF_TIMER1_COMPB,
+  PROF_TIMER1_OVF,
+  PROF_LATENCY,
+  PROF_USART_RXC = PROF_LATENCY,
+  PROF_USART_UDRE,
+  PROF_INT0,
+  PROF_VECTORS,
+};
+
+
+/* Takte, Klasse i < PROF_BINS-1 bis unter 32 << i, die letzte darueber */
+#define PROF_BINS       8
+#define PROF_BIN0       32
+
+struct ProfStat
+{
+  uint32_t n, sum;
+  uint16_t min, max;
+  uint16_t hist[PROF_BINS];
+};
+
+
+extern const __flash uint16_t prof_ram;
+
+extern void prof_isr (uint8_t vector, uint16_t tcnt1, uint16_t latency);
+extern void prof_take (uint8_t vector, struct ProfStat *run, struct ProfStat *latency);
+
+
+#endif
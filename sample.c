@@ -0,0 +1,107 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "defs.h"
+#include "hal.h"
+#include "timer1.h"
+#include "prof.h"
+#include "sample.h"
+
+
+/*
+ * Timer 2 tastet PD2 mit 1024 Hz ab und integriert die Absenkung
+ * (LO) in zwei Fenstern nach der Sekundenmarke: A ist in jeder
+ * Sekunde ausser 59 abgesenkt, B nur bei "1".  Die Raender der
+ * Impulse bei 100 ms und 200 ms bleiben aussen vor, B endet vor dem
+ * Auswertezeitpunkt von Timer 0.  Am Ende von B stehen die Summen in
+ * sample_low[].
+ *
+ * Timer 2 laeuft nur von sample_align() kurz nach der Sekundenmarke
+ * bis zum Ende von B, gut 170 von 1024 Abtastungen je Sekunde.
+ * Budget: das Abtasten selbst braucht etwa 50 Takte je Interrupt
+ * (0,2 % der CPU).  Die Messung fuer profile kommt immer dazu:
+ * hal_latency_t2(), timer1_isr_start() und prof_isr() mit zweimal
+ * record() samt Histogrammschleife, ausserdem sichert der Prolog
+ * wegen des Aufrufs alle call-clobbered Register.  Aus dem Code
+ * geschaetzt sind das etwa 350 Takte, zusammen also rund 400 Takte
+ * je Interrupt und gut 1,5 % der CPU.
+ */
+
+
+volatile uint8_t sample_low[2];
+volatile bool sample_ready;
+
+static volatile uint16_t sample_idx;
+static uint8_t low_a, low_b;
+
+
+/*******************
+ * Timer-2-Compare *
+ *******************/
+
+ISR (TIMER2_COMP_vect)
+{
+  const uint16_t latency = hal_latency_t2 ();
+  const uint16_t tcnt1 = timer1_isr_start ();
+  const uint16_t i = sample_idx;
+  const uint8_t lo = !hal_signal_state ();
+
+  if (i < SAMPLE_A0)
+  {
+  }
+  else if (i < SAMPLE_A1)
+  {
+    low_a += lo;
+  }
+  else if (i < SAMPLE_B0)
+  {
+  }
+  else if (i < SAMPLE_B1)
+  {
+    low_b += lo;
+  }
+  else if (i == SAMPLE_B1)
+  {
+    sample_low[0] = low_a;
+    sample_low[1] = low_b;
+    low_a = low_b = 0;
+    sample_ready = true;
+    hal_sample_run (false);
+  };
+
+  sample_idx = i + 1 < SAMPLE_HZ ? i + 1 : 0;
+
+  prof_isr (PROF_TIMER2_COMP, tcnt1, latency);
+}
+
+
+/* nur bei gesperrten Interrupts: Abtastzaehler auf die Sekundenmarke stellen und starten */
+void sample_align (uint32_t boundary)
+{
+  const uint16_t i = (timer1_get () - boundary) / (TIMER1VALUE_1S / SAMPLE_HZ);
+
+  if (i <= SAMPLE_A0)
+  {
+    sample_idx = i;
+  }
+  else
+  {
+    /* weit daneben: diese Sekunde ohne Fenster A */
+    sample_idx = i < SAMPLE_HZ ? i : 0;
+    low_a = low_b = 0;
+  };
+  hal_sample_run (sample_idx <= SAMPLE_B1);
+}
+
+
+void sample_init (void)
+{
+  hal_sample_init ();
+}
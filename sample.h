@@ -0,0 +1,31 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _SAMPLE_H
+#define _SAMPLE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define SAMPLE_HZ       1024
+#define SAMPLE_MS(ms)   ((uint16_t) ((uint32_t) (ms) * SAMPLE_HZ / 1000))
+
+/* Fenster A 10..90 ms, B 110..170 ms nach der Sekundenmarke */
+#define SAMPLE_A0       SAMPLE_MS(10)
+#define SAMPLE_A1       SAMPLE_MS(90)
+#define SAMPLE_B0       SAMPLE_MS(110)
+#define SAMPLE_B1       SAMPLE_MS(170)
+
+
+extern volatile uint8_t sample_low[2];
+extern volatile bool sample_ready;
+
+extern void sample_align (uint32_t boundary);
+extern void sample_init (void);
+
+
+#endif
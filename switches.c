@@ -6,16 +6,16 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
-#include <avr/io.h>
 
 #include "common.h"
 #include "defs.h"
 #include "switches.h"
+#include "hal.h"
 
 
 uint8_t read_switches ()
 {
-  return (PIN_SWITCHES & MASK_SWITCHES) ^ MASK_SWITCHES;
+  return hal_switches ();
 }
 
 
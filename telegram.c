@@ -0,0 +1,396 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/eeprom.h>
+
+#include "common.h"
+#include "telegram.h"
+#include "calendar.h"
+
+
+/*
+ * Das Zeittelegramm bleibt gerendert stehen.  telegram_render()
+ * schreibt alle Felder neu (Minutenwechsel, Quarz-/Sommerzeitstatus),
+ * telegram_set_sec() patcht jede Sekunde nur die beiden Sekundenziffern,
+ * bei NMEA dazu die Pruefsumme, beim Binaerformat die Sekunden seit
+ * 1970 und die CRC.
+ *
+ * Die Formate stehen als Schablone mit Feldpositionen im Flash, die
+ * Ziffern kommen unveraendert aus struct TimeInfo.  Ausgewaehlt wird
+ * zur Laufzeit mit telegram_select(), die Wahl bleibt im EEPROM.
+ */
+
+
+/* Uni Erlangen time string for PZF5xx receivers (9600E72, NTP mode 2): */
+static const __flash char t_pzf5x[] = STX "dd.mm.yy; w; hh:mm:ss; tuvxyza" ETX;
+
+/* Hopf 6021 receivers (9600N81, NTP mode 12): */
+static const __flash char t_hopf6021[] = STX "ABhhmmssddmmyy" LF CR ETX;
+
+/* Meinberg standard time string (9600E71, NTP parse mode 0): */
+static const __flash char t_meinberg[] = STX "D:dd.mm.yy;T:w;U:hh.mm.ss;uvxy" ETX;
+
+/* NMEA 0183, UTC (4800N81 fuer gpsd): */
+static const __flash char t_nmea_zda[] = "$GPZDA,hhmmss.00,dd,mm,20yy,00,00*CS" CR LF;
+static const __flash char t_nmea_rmc[] = "$GPRMC,hhmmss.00,A,,,,,,,ddmmyy,,*CS" CR LF;
+
+
+/* Laenge ohne NUL, auch fuer die Binaerschablone */
+#define TEMPLATE(t)     .templ = t, .len = sizeof t - 1
+
+
+enum
+{
+  F_UTC         = 0b00000001,
+  F_NMEA        = 0b00000010,
+  F_BINARY      = 0b00000100,
+};
+
+
+static void pzf5x_status (const struct TimeInfo *ti, bool quartz_time, char *p);
+static void hopf6021_status (const struct TimeInfo *ti, bool quartz_time, char *p);
+static void meinberg_status (const struct TimeInfo *ti, bool quartz_time, char *p);
+static void nmea_rmc_status (const struct TimeInfo *ti, bool quartz_time, char *p);
+
+
+/* Feldpositionen in der Schablone, 0 = Feld fehlt */
+static const __flash struct Format
+{
+  const __flash char *name;
+  const __flash char *templ;
+  uint8_t len, flags;
+  uint8_t day, mon, yr, wday, hr, min, sec, status;
+  void (*status_fn) (const struct TimeInfo *ti, bool quartz_time, char *p);
+}
+formats[FORMAT_MAX + 1] =
+{
+  [FORMAT_PZF5X] =
+  {
+    .name = FSTR("pzf5x"), TEMPLATE(t_pzf5x),
+    .day = 1, .mon = 4, .yr = 7, .wday = 11,
+    .hr = 14, .min = 17, .sec = 20, .status = 24,
+    .status_fn = pzf5x_status,
+  },
+  [FORMAT_HOPF6021] =
+  {
+    .name = FSTR("hopf6021"), TEMPLATE(t_hopf6021),
+    .status = 1, .hr = 3, .min = 5, .sec = 7,
+    .day = 9, .mon = 11, .yr = 13,
+    .status_fn = hopf6021_status,
+  },
+  [FORMAT_BINARY] =
+  {
+    .name = FSTR("binary"), .len = TG_LEN, .flags = F_BINARY,
+  },
+  [FORMAT_MEINBERG] =
+  {
+    .name = FSTR("meinberg"), TEMPLATE(t_meinberg),
+    .day = 3, .mon = 6, .yr = 9, .wday = 14,
+    .hr = 18, .min = 21, .sec = 24, .status = 27,
+    .status_fn = meinberg_status,
+  },
+  [FORMAT_NMEA_ZDA] =
+  {
+    .name = FSTR("zda"), TEMPLATE(t_nmea_zda), .flags = F_UTC | F_NMEA,
+    .hr = 7, .min = 9, .sec = 11,
+    .day = 17, .mon = 20, .yr = 25,
+  },
+  [FORMAT_NMEA_RMC] =
+  {
+    .name = FSTR("rmc"), TEMPLATE(t_nmea_rmc), .flags = F_UTC | F_NMEA,
+    .hr = 7, .min = 9, .sec = 11, .status = 17,
+    .day = 25, .mon = 27, .yr = 29,
+    .status_fn = nmea_rmc_status,
+  },
+};
+
+
+static uint8_t ee_format EEMEM = UINT8_MAX;
+
+/* Platz fuer das laengste Format und NUL */
+char time_string[40];
+uint8_t telegram_len, telegram_format;
+
+static uint16_t status_holdover;
+static uint8_t status_quality;
+
+/* zuletzt gerendert, fuer den Formatwechsel */
+static struct TimeInfo last_ti;
+static uint8_t last_sec;
+static bool last_quartz, have_ti;
+
+static uint32_t minute_epoch;
+
+const __flash uint16_t telegram_ram = sizeof time_string + sizeof last_ti;
+
+
+void telegram_set_status (uint16_t holdover_min, uint8_t quality)
+{
+  status_holdover = holdover_min;
+  status_quality = quality;
+}
+
+
+static uint8_t get2 (const char *digits)
+{
+  return (digits[0] - '0') * 10 + (digits[1] - '0');
+}
+
+
+static void put2 (uint8_t pos, const char *digits)
+{
+  time_string[pos]   = digits[0];
+  time_string[pos+1] = digits[1];
+}
+
+
+/****************
+ * Statusfelder *
+ ****************/
+
+static void pzf5x_status (const struct TimeInfo *ti, bool quartz_time, char *p)
+{
+  p[0] = ' ';                                   /* t: Lokalzeit */
+  p[1] = ' ';                                   /* u: wenigstens einmal synchronisiert */
+  p[2] = quartz_time   ? '*' : ' ';             /* v: Quarz j/n */
+  p[3] = ti->cest      ? 'S' : ' ';             /* x: Sommer-/Winterzeit */
+  p[4] = ti->tz_change ? '!' : ' ';             /* y: Wechsel Sommer-/Winterzeit anstehend */
+  p[5] = ti->leap      ? 'A' : ' ';             /* z: Schaltsekunde anstehend */
+  p[6] = ' ';                                   /* a: */
+}
+
+
+static const __flash char hex[] = "0123456789ABCDEF";
+
+
+static void hopf6021_status (const struct TimeInfo *ti, bool quartz_time, char *p)
+{
+  const uint8_t status =
+    (quartz_time   ? 0b01000000 : 0b11000000) |
+    (ti->cest      ? 0b00100000 : 0b00000000) |
+    (ti->tz_change ? 0b00010000 : 0b00000000) |
+    (ti->wday[0] & 0b00000111);
+  p[0] = hex[status >> 4];
+  p[1] = hex[status & 0x0F];
+}
+
+
+static void meinberg_status (const struct TimeInfo *ti, bool quartz_time, char *p)
+{
+  p[0] = ' ';                                   /* u: seit Reset synchronisiert */
+  p[1] = quartz_time   ? '*' : ' ';             /* v: Quarz */
+  p[2] = ti->cest      ? 'S' : ' ';             /* x: Sommerzeit */
+  p[3] = ti->tz_change ? '!' : ti->leap ? 'A' : ' ';    /* y: Ankuendigung */
+}
+
+
+/* A = gueltig, V = nur Quarz */
+static void nmea_rmc_status (const struct TimeInfo *ti, bool quartz_time, char *p)
+{
+  p[0] = quartz_time ? 'V' : 'A';
+}
+
+
+/* XOR zwischen '$' und '*' */
+static void nmea_checksum (void)
+{
+  uint8_t cs = 0;
+  uint8_t i = 1;
+
+  for (; time_string[i] != '*'; ++i)
+  {
+    cs ^= time_string[i];
+  };
+  time_string[i+1] = hex[cs >> 4];
+  time_string[i+2] = hex[cs & 0x0F];
+}
+
+
+/****************
+ * Binaerformat *
+ ****************/
+
+/* UTC-Sekunden seit 1970 zu Beginn der dekodierten Minute (Lokalzeit 2000..2099) */
+static uint32_t epoch (const struct TimeInfo *ti)
+{
+  static const __flash uint16_t mdays[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+  const uint8_t yr = get2 (ti->yr), mon = get2 (ti->mon);
+  uint16_t days = 10957 + 365 * yr + (yr + 3) / 4 + mdays[mon - 1] + get2 (ti->day) - 1;
+
+  if (mon > 2 && yr % 4 == 0)
+  {
+    ++days;
+  };
+  return (uint32_t) days * 86400
+         + (uint32_t) get2 (ti->hr) * 3600 + get2 (ti->min) * 60
+         - (ti->cest ? 7200 : 3600);
+}
+
+
+static void put_le (uint8_t pos, uint32_t v, uint8_t n)
+{
+  while (n--)
+  {
+    time_string[pos++] = v;
+    v >>= 8;
+  }
+}
+
+
+static void put_crc (void)
+{
+  uint16_t crc = 0xFFFF;
+
+  for (uint8_t i = TG_EPOCH; i < TG_CRC; ++i)
+  {
+    crc = telegram_crc16 (crc, time_string[i]);
+  };
+  put_le (TG_CRC, crc, 2);
+}
+
+
+/***********
+ * Rendern *
+ ***********/
+
+void telegram_set_sec (uint8_t sec)
+{
+  const __flash struct Format *f = &formats[telegram_format];
+
+  last_sec = sec;
+  if (f->flags & F_BINARY)
+  {
+    put_le (TG_EPOCH, minute_epoch + sec, 4);
+    put_crc ();
+    return;
+  };
+
+  char tens = '0';
+
+  while (sec >= 10)
+  {
+    sec -= 10;
+    ++tens;
+  };
+  time_string[f->sec]   = tens;
+  time_string[f->sec+1] = '0' + sec;
+
+  if (f->flags & F_NMEA)
+  {
+    nmea_checksum ();
+  }
+}
+
+
+void telegram_render (const struct TimeInfo *ti, uint8_t sec, bool quartz_time)
+{
+  const __flash struct Format *f = &formats[telegram_format];
+  struct TimeInfo utc;
+
+  last_ti = *ti;
+  last_quartz = quartz_time;
+  have_ti = true;
+
+  if (f->flags & F_BINARY)
+  {
+    minute_epoch = epoch (ti);
+    time_string[TG_STATUS] =
+      (quartz_time   ? TG_QUARTZ    : 0) |
+      (ti->cest      ? TG_CEST      : 0) |
+      (ti->tz_change ? TG_TZ_CHANGE : 0) |
+      (ti->leap      ? TG_LEAP      : 0);
+    put_le (TG_HOLDOVER, status_holdover, 2);
+    time_string[TG_QUALITY] = status_quality;
+    telegram_set_sec (sec);
+    return;
+  };
+
+  if (f->flags & F_UTC)
+  {
+    utc = *ti;
+    calendar_utc (&utc);
+    ti = &utc;
+  };
+
+  put2 (f->hr,  ti->hr);
+  put2 (f->min, ti->min);
+  put2 (f->day, ti->day);
+  put2 (f->mon, ti->mon);
+  put2 (f->yr,  ti->yr);
+  if (f->wday)
+  {
+    time_string[f->wday] = ti->wday[0];
+  };
+  if (f->status_fn)
+  {
+    f->status_fn (ti, quartz_time, &time_string[f->status]);
+  };
+  telegram_set_sec (sec);
+}
+
+
+/*****************
+ * Formatauswahl *
+ *****************/
+
+const __flash char *telegram_name (uint8_t format)
+{
+  return format <= FORMAT_MAX ? formats[format].name : NULL;
+}
+
+
+bool telegram_binary (void)
+{
+  return formats[telegram_format].flags & F_BINARY;
+}
+
+
+bool telegram_select (uint8_t format)
+{
+  if (!telegram_name (format))
+  {
+    return false;
+  };
+
+  const __flash struct Format *f = &formats[format];
+
+  telegram_format = format;
+  telegram_len = f->len;
+  if (f->flags & F_BINARY)
+  {
+    time_string[0] = TG_SYNC0;
+    time_string[1] = TG_SYNC1;
+  }
+  else
+  {
+    for (uint8_t i = 0; i <= f->len; ++i)
+    {
+      time_string[i] = f->templ[i];
+    }
+  };
+
+  if (have_ti)
+  {
+    telegram_render (&last_ti, last_sec, last_quartz);
+  };
+  return true;
+}
+
+
+void telegram_store (void)
+{
+  eeprom_update_byte (&ee_format, telegram_format);
+}
+
+
+void telegram_init (void)
+{
+  if (!telegram_select (eeprom_read_byte (&ee_format)))
+  {
+    telegram_select (FORMAT);
+  }
+}
@@ -0,0 +1,92 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _TELEGRAM_H
+#define _TELEGRAM_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Nummern der Formate, FORMAT ist die Voreinstellung */
+#define FORMAT_PZF5X    1
+#define FORMAT_HOPF6021 2
+#define FORMAT_BINARY   3
+#define FORMAT_MEINBERG 4
+#define FORMAT_NMEA_ZDA 5
+#define FORMAT_NMEA_RMC 6
+#define FORMAT_MAX      6
+
+#ifndef FORMAT
+#error
+#endif
+
+
+#define STX     "\x02"
+#define ETX     "\x03"
+#define CR      "\r"
+#define LF      "\n"
+
+
+/*
+ * FORMAT_BINARY: 12 Byte, Mehrbyte-Werte little endian
+ *
+ *   0  TG_SYNC0, TG_SYNC1
+ *   2  UTC-Sekunden seit 1970
+ *   6  Status TG_*
+ *   7  Minuten Quarzbetrieb seit der letzten dekodierten Minute
+ *   9  Signalqualitaet der letzten Minute, 0..100
+ *  10  CRC-16/CCITT-FALSE ueber die Bytes 2..9
+ */
+#define TG_SYNC0        0xA5
+#define TG_SYNC1        0x5A
+
+#define TG_QUARTZ       0b00000001
+#define TG_CEST         0b00000010
+#define TG_TZ_CHANGE    0b00000100
+#define TG_LEAP         0b00001000
+
+enum
+{
+  TG_EPOCH = 2, TG_STATUS = 6, TG_HOLDOVER = 7, TG_QUALITY = 9,
+  TG_CRC = 10, TG_LEN = 12
+};
+
+
+/* CRC-16/CCITT-FALSE, Startwert 0xFFFF */
+static inline uint16_t telegram_crc16 (uint16_t crc, uint8_t b)
+{
+  crc ^= (uint16_t) b << 8;
+  for (uint8_t i = 0; i < 8; ++i)
+  {
+    crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  };
+  return crc;
+}
+
+
+struct TimeInfo
+{
+  char min[2], hr[2], day[2], wday[1], mon[2], yr[2];
+  bool tz_change, cet, cest, leap;
+};
+
+
+extern char time_string[];
+extern uint8_t telegram_len, telegram_format;
+extern const __flash uint16_t telegram_ram;
+
+extern void telegram_init (void);
+extern bool telegram_select (uint8_t format);
+extern void telegram_store (void);
+extern const __flash char *telegram_name (uint8_t format);
+extern bool telegram_binary (void);
+extern void telegram_set_status (uint16_t holdover_min, uint8_t quality);
+extern void telegram_render (const struct TimeInfo *ti, uint8_t sec, bool quartz_time);
+extern void telegram_set_sec (uint8_t sec);
+
+
+#endif
@@ -1,29 +1,28 @@
 /* timer.c */
 
 
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
+#include <stdint.h>
 #include "timer.h"
+#include "timer1.h"
 #include "defs.h"
-
-
-volatile int32_t microsecs;
+#include "hal.h"
+#include "power.h"
 
 
 /**********************
  * Mikrosekundentimer *
  **********************/
 
-int32_t now (void)
+/*
+ * Mikrosekunden seit dem Start aus den 48 Bit von Timer 1, auf 1,9 µs
+ * aufgeloest und erst nach 17 Jahren uebergelaufen.  Nicht aus
+ * Interrupts aufrufen.
+ */
+int64_t now (void)
 {
-  long us;
+  const uint64_t t = timer1_get64 ();
 
-  do
-  {
-    us = microsecs;
-  }
-  while (us != microsecs);
-  return us;
+  return t / TIMER1VALUE_1S * 1000000 + t % TIMER1VALUE_1S * 1000000 / TIMER1VALUE_1S;
 }
 
 
@@ -31,37 +30,37 @@ int32_t now (void)
  * Zeitmessung *
  ***************/
 
-void mark (int32_t *since)
+void mark (int64_t *since)
 {
   *since = now ();
 }
 
 
-int32_t elapsed (int32_t *since)
+int64_t elapsed (int64_t *since)
 {
   return now () - *since;
 }
 
 
-int32_t elapsed_mark (int32_t *since)
+int64_t elapsed_mark (int64_t *since)
 {
-  const int32_t n = now ();
-  const int32_t dif = n - *since;
+  const int64_t n = now ();
+  const int64_t dif = n - *since;
   *since = n;
   return dif;
 }
 
 
-bool is_elapsed (int32_t *since, const int32_t howlong)
+bool is_elapsed (int64_t *since, const int64_t howlong)
 {
   return elapsed (since) - howlong >= 0;
 }
 
 
-bool is_elapsed_mark (int32_t *since, int32_t howlong)
+bool is_elapsed_mark (int64_t *since, int64_t howlong)
 {
-  const int32_t n = now ();
-  const int32_t dif = n - *since;
+  const int64_t n = now ();
+  const int64_t dif = n - *since;
   const bool is_elapsed = dif - howlong >= 0;
   if (is_elapsed)
   {
@@ -85,17 +84,12 @@ void (*sleep_background_action) (void) = no_background_action;
 
 void sleep (void)
 {
-  cli ();
-  set_sleep_mode (SLEEP_MODE_IDLE);
-  sleep_enable ();
-  sei ();
-  sleep_cpu ();
-  sleep_disable ();
+  power_sleep ();
   sleep_background_action ();
 }
 
 
-void sleep_until (const int32_t us)
+void sleep_until (const int64_t us)
 {
   do
   {
@@ -105,7 +99,7 @@ void sleep_until (const int32_t us)
 }
 
 
-void sleep_for (const long us)
+void sleep_for (const int64_t us)
 {
   sleep_until (now () + us);
 }
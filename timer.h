@@ -8,20 +8,19 @@
 
 
 #include <stdbool.h>
+#include <stdint.h>
 
 
-extern volatile int32_t microsecs;
-
-extern long now (void);
-extern void mark (long *since);
-extern long elapsed (long *since);
-extern long elapsed_mark (long *since);
-extern bool is_elapsed (int32_t *since, int32_t howlong);
-extern bool is_elapsed_mark (int32_t *since, int32_t howlong);
+extern int64_t now (void);
+extern void mark (int64_t *since);
+extern int64_t elapsed (int64_t *since);
+extern int64_t elapsed_mark (int64_t *since);
+extern bool is_elapsed (int64_t *since, int64_t howlong);
+extern bool is_elapsed_mark (int64_t *since, int64_t howlong);
 extern void (*sleep_background_action) (void);
 extern void sleep (void);
-extern void sleep_until (const int32_t usecs);
-extern void sleep_for (const int32_t usecs);
+extern void sleep_until (const int64_t usecs);
+extern void sleep_for (const int64_t usecs);
 
 
 #endif
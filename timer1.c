@@ -0,0 +1,237 @@
+/*
+ * $Header$
+ */
+
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "hal.h"
+#include "prof.h"
+#include "timer1.h"
+
+
+/*
+ * Timer 1 laeuft frei mit F_CPU/TIMER1PRESCALE, der Ueberlauf-
+ * Interrupt verlaengert ihn auf 32 Bit.  Jede fallende Flanke an
+ * ICP1 wird in ICR1 gelatcht, timer1_capture ist ihr Zeitstempel.
+ *
+ * Der Ueberlaufzaehler hat selbst 32 Bit, timer1_get64() liest daraus
+ * und aus TCNT1 48 Bit ohne Interrupts zu sperren: timer1_seq zaehlt
+ * bei jedem Ueberlauf und bei jedem 16-Bit-Lesen in Interrupts (die
+ * das TEMP-Register von Timer 1 ueberschreiben), der Leser wiederholt,
+ * bis sich timer1_seq waehrend des Lesens nicht geaendert hat.  Jede
+ * ISR beginnt ihre Messung deshalb mit timer1_isr_start() statt mit
+ * hal_cycles_start(); einmal je ISR genuegt, weil keine ISR andere
+ * Interrupts freigibt.
+ *
+ * OCR1A/OCR1B passen in jedem Umlauf (125 ms).  timer1_compare() gibt
+ * den Interrupt erst frei, wenn der naechste Match der bestellte
+ * Zeitpunkt ist, beim Bestellen oder im Ueberlauf davor.  Zeitpunkte
+ * bis COMPARE_MARGIN nach einem Ueberlauf werden schon einen Umlauf
+ * frueher freigegeben, damit ein verspaeteter Ueberlauf-Interrupt sie
+ * nicht verpasst; den einen fruehen Match verwirft die ISR selbst.
+ */
+
+
+/* laenger als jede Latenz des Ueberlauf-Interrupts */
+#define COMPARE_MARGIN  0x100
+
+
+long count_capt;
+uint32_t timer1_capture;
+
+static volatile uint32_t timer1_high;
+static volatile uint8_t timer1_seq;
+
+static uint32_t compare_at[2];
+static bool compare_armed[2];
+
+
+static void dummy (void)
+{
+}
+
+
+void (*timer1_capture_callback) (void) = dummy;
+
+
+/* ein noch nicht bedienter Ueberlauf zaehlt fuer kleine Werte schon mit */
+static inline uint32_t extend (uint16_t low)
+{
+  uint16_t high = timer1_high;
+
+  ++timer1_seq;
+  if (hal_t1_overflow () && low < 0x8000)
+  {
+    ++high;
+  };
+  return (uint32_t) high << 16 | low;
+}
+
+
+/* nur bei gesperrten Interrupts */
+uint32_t timer1_get (void)
+{
+  return extend (hal_get_tcnt1 ());
+}
+
+
+uint32_t timer1_now (void)
+{
+  cli ();
+  const uint32_t t = timer1_get ();
+  sei ();
+  return t;
+}
+
+
+/* am Anfang jeder ISR, nach hal_latency_*() */
+uint16_t timer1_isr_start (void)
+{
+  ++timer1_seq;
+  return hal_cycles_start ();
+}
+
+
+/* 48 Bit monoton, nur ausserhalb von Interrupts */
+uint64_t timer1_get64 (void)
+{
+  uint8_t seq;
+  uint32_t high;
+  uint16_t low;
+  bool ovf;
+
+  do
+  {
+    seq = timer1_seq;
+    high = timer1_high;
+    low = hal_get_tcnt1 ();
+    ovf = hal_t1_overflow ();
+  }
+  while (seq != timer1_seq);
+
+  if (ovf && low < 0x8000)
+  {
+    ++high;
+  };
+  return (uint64_t) high << 16 | low;
+}
+
+
+/***********************
+ * Timer-1-Compare A/B *
+ ***********************/
+
+static void compare_irq (uint8_t ch, bool on)
+{
+  if (ch == T1_COMPARE_A)
+  {
+    hal_ocie1a (on);
+  }
+  else
+  {
+    hal_ocie1b (on);
+  }
+}
+
+
+static void compare_gate (uint8_t ch, uint32_t now)
+{
+  const int32_t d = compare_at[ch] - now;
+
+  if (d > 0x10000L + COMPARE_MARGIN)
+  {
+    compare_irq (ch, false);
+    return;
+  };
+
+  /* alte Matches verwerfen, solange der faellige nicht unmittelbar bevorsteht */
+  if (d > COMPARE_MARGIN)
+  {
+    if (ch == T1_COMPARE_A)
+    {
+      hal_clear_ocf1a ();
+    }
+    else
+    {
+      hal_clear_ocf1b ();
+    }
+  };
+  compare_irq (ch, true);
+}
+
+
+/* nur bei gesperrten Interrupts, at hoechstens ein paar Sekunden voraus */
+void timer1_compare (uint8_t ch, uint32_t at)
+{
+  compare_at[ch] = at;
+  compare_armed[ch] = true;
+  if (ch == T1_COMPARE_A)
+  {
+    hal_set_ocr1a (at);
+  }
+  else
+  {
+    hal_set_ocr1b (at);
+  };
+  compare_gate (ch, timer1_get ());
+}
+
+
+/* nur bei gesperrten Interrupts */
+void timer1_compare_off (uint8_t ch)
+{
+  compare_armed[ch] = false;
+  compare_irq (ch, false);
+}
+
+
+/*********************
+ * Timer-1-Ueberlauf *
+ *********************/
+
+ISR (TIMER1_OVF_vect)
+{
+  const uint16_t latency = hal_latency_ovf ();
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  ++timer1_high;
+  ++timer1_seq;
+
+  const uint32_t now = timer1_get ();
+  for (uint8_t ch = T1_COMPARE_A; ch <= T1_COMPARE_B; ++ch)
+  {
+    if (compare_armed[ch])
+    {
+      compare_gate (ch, now);
+    }
+  };
+
+  prof_isr (PROF_TIMER1_OVF, tcnt1, latency);
+}
+
+
+/*************************
+ * Timer-1-Input-Capture *
+ *************************/
+
+ISR (TIMER1_CAPT_vect)
+{
+  const uint16_t latency = hal_latency_capt ();
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  ++count_capt;
+  timer1_capture = extend (hal_get_icr1 ());
+  timer1_capture_callback ();
+
+  prof_isr (PROF_TIMER1_CAPT, tcnt1, latency);
+}
+
+
+void timer1_init (void)
+{
+  hal_capture_init ();
+}
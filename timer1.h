@@ -0,0 +1,40 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _TIMER1_H
+#define _TIMER1_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* Umrechnung Timer-1-Takte <-> µs, gerundet */
+#define T1_TO_US(t)     ((int32_t) (((int64_t) (t) * 1000000 + ((t) < 0 ? -1 : 1) * (TIMER1VALUE_1S / 2)) / TIMER1VALUE_1S))
+#define US_TO_T1(us)    ((int32_t) (((int64_t) (us) * TIMER1VALUE_1S + ((us) < 0 ? -1 : 1) * 500000) / 1000000))
+
+
+/* Kanaele fuer timer1_compare() */
+enum
+{
+  T1_COMPARE_A,
+  T1_COMPARE_B,
+};
+
+
+extern long count_capt;
+extern uint32_t timer1_capture;
+
+extern void (*timer1_capture_callback) (void);
+extern uint32_t timer1_get (void);
+extern uint32_t timer1_now (void);
+extern uint64_t timer1_get64 (void);
+extern uint16_t timer1_isr_start (void);
+extern void timer1_compare (uint8_t ch, uint32_t at);
+extern void timer1_compare_off (uint8_t ch);
+extern void timer1_init (void);
+
+
+#endif
@@ -5,18 +5,28 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
-#include <avr/io.h>
 #include <avr/interrupt.h>
 
 #include "common.h"
 #include "defs.h"
-#include "timer.h"
+#include "hal.h"
+#include "timer1.h"
+#include "prof.h"
 #include "timerint.h"
 
 
-/*********************
- * Timer-0-Interrupt *
- *********************/
+/*
+ * Timer 0 weckt nur zu den Zeitpunkten, die mit timerint0_at()
+ * bestellt werden (Timer-1-Zeitstempel), und ruft dann den Callback.
+ * Ein Compare-Intervall ist hoechstens 256 Schritte (62,5 ms) lang,
+ * weiter entfernte Zeitpunkte werden in Teilstrecken erreicht.  Ohne
+ * Bestellung laeuft Timer 0 mit vollen Intervallen.
+ */
+
+
+#define T1_PER_T0       (TIMER0PRESCALE / TIMER1PRESCALE)
+#define T0_STEPS_MIN    2
+#define T0_STEPS_MAX    256
 
 
 static void dummy (void)
@@ -26,29 +36,74 @@ static void dummy (void)
 
 void (*timerint0_callback) (void) = dummy;
 
+static uint32_t t0_deadline;
+static bool t0_pending;
+
+
+/*
+ * naechstes Intervall nach dem Compare-Match, t ist jetzt.  TCNT0
+ * zaehlt seit dem Match schon mit (Latenz und Callback), OCR0 muss
+ * darueber liegen, sonst laeuft Timer 0 einmal ganz herum (62,5 ms).
+ */
+static void program (uint32_t t)
+{
+  const uint8_t tcnt0 = hal_get_tcnt0 ();
+  int32_t steps = T0_STEPS_MAX;
+
+  if (t0_pending)
+  {
+    steps = tcnt0 + ((int32_t) (t0_deadline - t) + T1_PER_T0 / 2) / T1_PER_T0;
+  };
+  if (steps < tcnt0 + T0_STEPS_MIN)
+  {
+    steps = tcnt0 + T0_STEPS_MIN;
+  };
+  if (steps > T0_STEPS_MAX)
+  {
+    steps = T0_STEPS_MAX;
+  };
+  hal_set_ocr0 (steps - 1);
+}
+
+
+/*********************
+ * Timer-0-Interrupt *
+ *********************/
 
 ISR (TIMER0_COMP_vect)
 {
-  microsecs += TIMER0USECS;
-  timerint0_callback ();
+  const uint16_t latency = hal_latency_t0 ();
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  if (t0_pending && (int32_t) (t0_deadline - timer1_get ()) <= T1_PER_T0 / 2)
+  {
+    t0_pending = false;
+    timerint0_callback ();
+  };
+  program (timer1_get ());
+
+  prof_isr (PROF_TIMER0_COMP, tcnt1, latency);
+}
+
+
+/* aus dem Callback: naechster Weckzeitpunkt */
+void timerint0_at (uint32_t t)
+{
+  t0_deadline = t;
+  t0_pending = true;
+}
+
+
+/* aus anderen Interrupts: laufendes Intervall abbrechen und neu bestellen */
+void timerint0_restart (uint32_t t)
+{
+  hal_set_tcnt0 (0);
+  timerint0_at (t);
+  program (timer1_get ());
 }
 
 
 void timer_init (void)
 {
-#if TIMER0PRESCALE != 1024
-#error
-#endif
-  TCCR0  = _BV(WGM01) | _BV(CS02) | _BV(CS00);
-  OCR0   = TIMER0CMPVALUE;
-  TCNT0  = 0;
-
-#if TIMER1PRESCALE != 1024
-#error
-#endif
-  TCCR1A = 0;
-  TCCR1B = _BV(CS12) | _BV(CS10);
-  TCNT1  = 0;
-
-  TIMSK  = _BV(OCIE0);
+  hal_timer_init ();
 }
@@ -7,7 +7,12 @@
 #define _TIMERINT_H
 
 
+#include <stdint.h>
+
+
 extern void (*timerint0_callback) (void);
+extern void timerint0_at (uint32_t t);
+extern void timerint0_restart (uint32_t t);
 extern void timer_init (void);
 
 
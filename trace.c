@@ -0,0 +1,93 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/interrupt.h>
+
+#include "common.h"
+#include "uart.h"
+#include "telegram.h"
+#include "trace.h"
+
+
+/*
+ * Ereignisring fuer die Fehlersuche nach Empfangsabbruechen: Flanken,
+ * Timer-0-Zustaende, Bits, Protokollspruenge, Fehler und Telegramme,
+ * je 8 Byte mit Timer-1-Zeitstempel.  Aus Interrupts schreibt
+ * trace_put() direkt, aus der Hintergrundaktion trace().
+ * trace_trigger() haelt den Ring nach TRACE_POST weiteren Ereignissen
+ * an, damit Vorgeschichte und Folgen erhalten bleiben; trace_dump()
+ * gibt ihn binaer aus und startet ihn neu.
+ */
+
+
+struct TraceEvent trace_ring[TRACE_LEN];
+uint8_t trace_next, trace_used, trace_stop;
+uint16_t trace_lost;
+
+
+void trace (uint8_t type, uint8_t a, uint16_t b, uint32_t t)
+{
+  cli ();
+  trace_put (type, a, b, t);
+  sei ();
+}
+
+
+/* nach TRACE_POST weiteren Ereignissen anhalten, wenn nicht schon geschehen */
+void trace_trigger (void)
+{
+  cli ();
+  if (trace_stop == 0)
+  {
+    trace_stop = TRACE_POST + 1;
+  };
+  sei ();
+}
+
+
+static uint16_t put (uint16_t crc, uint32_t v, uint8_t n)
+{
+  while (n--)
+  {
+    uart_putc (v);
+    crc = telegram_crc16 (crc, v);
+    v >>= 8;
+  };
+  return crc;
+}
+
+
+void trace_dump (void)
+{
+  /* waehrend der Ausgabe steht der Ring, neue Ereignisse zaehlen als verloren */
+  cli ();
+  const uint8_t used = trace_used, stopped = trace_stop == 1;
+  const uint16_t lost = trace_lost;
+  trace_stop = 1;
+  sei ();
+
+  uint16_t crc = 0xFFFF;
+  uart_putc (TR_SYNC0);
+  uart_putc (TR_SYNC1);
+  crc = put (crc, used, 1);
+  crc = put (crc, stopped, 1);
+  crc = put (crc, lost, 2);
+  for (uint8_t i = (uint8_t) (trace_next - used) % TRACE_LEN, n = used; n; --n, i = (i + 1) % TRACE_LEN)
+  {
+    const struct TraceEvent *e = &trace_ring[i];
+    crc = put (crc, e->t, 4);
+    crc = put (crc, e->type, 1);
+    crc = put (crc, e->a, 1);
+    crc = put (crc, e->b, 2);
+  };
+  put (crc, crc, 2);
+
+  cli ();
+  trace_used = trace_stop = 0;
+  trace_lost -= lost;
+  sei ();
+}
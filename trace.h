@@ -0,0 +1,81 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#if TRACE_LEN & (TRACE_LEN - 1) || TRACE_LEN > 128
+#error
+#endif
+
+/* so viele Ereignisse nach trace_trigger(), dann steht der Ring bis zum Auslesen */
+#define TRACE_POST      (TRACE_LEN / 2)
+
+
+/*
+ * Ausgabe von trace_dump(), Zahlen little-endian:
+ *
+ *   0  TR_SYNC0, TR_SYNC1
+ *   2  Anzahl n
+ *   3  1: von trace_trigger() angehalten
+ *   4  verlorene Ereignisse (2)
+ *   6  n Ereignisse, das aelteste zuerst: Timer 1 (4), Art, a, b (2)
+ *   6+8n  CRC-16 wie beim Binaertelegramm ueber Byte 2..5+8n
+ */
+#define TR_SYNC0        0xA5
+#define TR_SYNC1        0xC3
+#define TR_HEAD         6
+#define TR_EVENT        8
+
+enum TraceType
+{
+  TR_EDGE = 1,          /* Flanke: a = ei_state | 0x80 gueltig, b = last_tcnt1 / 32 */
+  TR_TI,                /* Timer-0-Zustand: a = ti_state */
+  TR_BIT,               /* Bit: a = bit_state (0xFF ohne Abtastung), b = sec << 8 | conf */
+  TR_STATE,             /* Protokollsprung: a = state, b = vorher */
+  TR_ERROR,             /* Fehler: a = FrameError, b = Zeile */
+  TR_EMIT,              /* Telegramm freigegeben */
+  TR_LATE,              /* Telegramm verworfen, zu spaet: a = Sekunde */
+};
+
+struct TraceEvent
+{
+  uint32_t t;
+  uint8_t type, a;
+  uint16_t b;
+};
+
+
+extern struct TraceEvent trace_ring[TRACE_LEN];
+extern uint8_t trace_next, trace_used, trace_stop;
+extern uint16_t trace_lost;
+
+
+/* nur bei gesperrten Interrupts */
+static inline void trace_put (uint8_t type, uint8_t a, uint16_t b, uint32_t t)
+{
+  if (trace_stop == 1)
+  {
+    trace_lost += trace_lost < UINT16_MAX;
+    return;
+  };
+  trace_ring[trace_next] = (struct TraceEvent) { .t = t, .type = type, .a = a, .b = b };
+  trace_next = (trace_next + 1) % TRACE_LEN;
+  trace_used += trace_used < TRACE_LEN;
+  trace_stop -= trace_stop > 1;
+}
+
+
+extern void trace (uint8_t type, uint8_t a, uint16_t b, uint32_t t);
+extern void trace_trigger (void);
+extern void trace_dump (void);
+
+
+#endif
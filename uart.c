@@ -7,13 +7,14 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdio.h>
-#include <avr/io.h>
 #include <avr/interrupt.h>
-#include <avr/sleep.h>
 #include <avr/pgmspace.h>
 
 #include "common.h"
 #include "switches.h"
+#include "hal.h"
+#include "timer1.h"
+#include "prof.h"
 #define CBUF_ID         u_
 #define CBUF_LEN        UART_CBUF_LEN
 #define CBUF_TYPE       uint8_t
@@ -21,7 +22,11 @@
 #include "uart.h"
 
 
-static struct u_CBuf uart_rxd;
+static struct u_CBuf uart_rxd, uart_txd;
+static bool uart_txc_wait, uart_held;
+
+/* UDRE sendet bis hierher, dahinter liegt zurueckgehaltene Ausgabe */
+static volatile uint8_t uart_tx_limit;
 
 
 static void dummy_sleep (void)
@@ -38,46 +43,119 @@ void (*uart_sleep) (void) = dummy_sleep;
 void (*uart_inevent) (uint8_t c) = dummy_event;
 
 
-static void uart_receive ()
+long uart_count_rxc;
+long uart_count_fe;
+long uart_count_dor;
+long uart_count_pe;
+long uart_count_overrun;
+
+
+/*****************
+ * RXC-Interrupt *
+ *****************/
+
+ISR (USART_RXC_vect)
 {
-  const uint8_t status = UCSRA;
+  const uint16_t tcnt1 = timer1_isr_start ();
+  const uint8_t status = hal_uart_status ();
+  uint8_t c = hal_uart_getc ();
 
-  if (status & _BV(RXC))
+  ++uart_count_rxc;
+  if (status & (HAL_UART_FE | HAL_UART_DOR | HAL_UART_PE))
   {
-    uint8_t c = UDR;
-
-    if (status & (_BV(FE) | _BV(DOR) | _BV(PE)))
-    {
-      c = '~';
-    };
+    uart_count_fe  += !!(status & HAL_UART_FE);
+    uart_count_dor += !!(status & HAL_UART_DOR);
+    uart_count_pe  += !!(status & HAL_UART_PE);
+    c = '~';
+  };
 
-    if (!u_full (&uart_rxd))
-    {
-      u_put (&uart_rxd, c);
-    }
-    else
-    {
-      u_set_overrun (&uart_rxd);
-    };
-    uart_inevent (c);
+  if (!u_full (&uart_rxd))
+  {
+    u_put (&uart_rxd, c);
   }
+  else
+  {
+    ++uart_count_overrun;
+    u_set_overrun (&uart_rxd);
+  };
+  uart_inevent (c);
+
+  prof_isr (PROF_USART_RXC, tcnt1, 0);
+}
+
+
+/******************
+ * UDRE-Interrupt *
+ ******************/
+
+ISR (USART_UDRE_vect)
+{
+  const uint16_t tcnt1 = timer1_isr_start ();
+
+  if (uart_txd.get != uart_tx_limit)
+  {
+    hal_uart_putc (u_get (&uart_txd));
+  };
+  if (uart_txd.get == uart_tx_limit)
+  {
+    hal_uart_udrie (false);
+  };
+
+  prof_isr (PROF_USART_UDRE, tcnt1, 0);
 }
 
 
 static inline bool uart_transmit (uint8_t c)
 {
-  if (UCSRA & _BV(UDRE))
+  if (!u_full (&uart_txd))
   {
-    UDR = c;
+    u_put (&uart_txd, c);
+    uart_txc_wait = true;
+    if (!uart_held)
+    {
+      uart_tx_limit = uart_txd.put;
+      hal_uart_udrie (true);
+    };
     return true;
   };
   return false;
 }
 
 
+/*
+ * Bei uart_hold (true) bleibt die Ausgabe im Puffer, bis
+ * uart_release() sie aus einem Interrupt heraus freigibt.
+ */
+void uart_hold (bool on)
+{
+  uart_held = on;
+}
+
+
+/* nur mit gesperrten Interrupts; das erste Zeichen geht sofort raus */
+void uart_release (void)
+{
+  uart_tx_limit = uart_txd.put;
+  if (uart_txd.get != uart_tx_limit)
+  {
+    if (hal_uart_status () & HAL_UART_UDRE)
+    {
+      hal_uart_putc (u_get (&uart_txd));
+    };
+    hal_uart_udrie (true);
+  }
+}
+
+
+/* verwirft die zurueckgehaltene Ausgabe */
+void uart_discard (void)
+{
+  uart_txd.put = uart_tx_limit;
+}
+
+
 int uart_getc_nowait (void)
 {
-  uart_receive ();
   if (!u_empty (&uart_rxd))
   {
     return u_get (&uart_rxd);
@@ -89,49 +167,56 @@ int uart_getc_nowait (void)
 
 uint8_t uart_getc (void)
 {
-  do
+  while (u_empty (&uart_rxd))
   {
-    uart_receive ();
     uart_sleep ();
-  }
-  while (u_empty (&uart_rxd));
+  };
   return u_get (&uart_rxd);
 }
 
 
 bool uart_putc_nowait (uint8_t c)
 {
-  uart_receive ();
   return uart_transmit (c);
 }
 
 
 void uart_putc (uint8_t c)
 {
-  do
+  while (!uart_transmit (c))
   {
-    uart_receive ();
   }
-  while (!uart_transmit (c));
 }
 
 
 int uart_in_peek (void)
 {
-  uart_receive ();
   return u_peek (&uart_rxd);
 }
 
 
 bool uart_in_empty ()
 {
-  uart_receive ();
   return u_empty (&uart_rxd);
 }
 
 
+uint16_t uart_in_used ()
+{
+  return u_used (&uart_rxd);
+}
+
+
+/* wartet, bis alle Zeichen gesendet sind */
 void uart_drain ()
 {
+  while (uart_txd.get != uart_tx_limit)
+  {
+  };
+  while (uart_txc_wait && !(hal_uart_status () & HAL_UART_TXC))
+  {
+  };
+  uart_txc_wait = false;
 }
 
 
@@ -143,133 +228,48 @@ void uart_flush ()
 }
 
 
-static const uint8_t baudrates[][2] =
+uint16_t uart_out_avail ()
 {
-#define BAUD    9600
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    4800
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    2400
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    1200
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    600
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    300
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    300
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-
-#define BAUD    300
-#include <util/setbaud.h>
-#if USE2X
-#error
-#endif
-  { UBRRH_VALUE, UBRRL_VALUE },
-#undef BAUD
-};
+  return u_avail (&uart_txd);
+}
 
 
-void uart_init (void)
+/* vfprintf_P schreibt Zeichen fuer Zeichen in den Sendepuffer, ohne Zwischenpuffer auf dem Stack */
+static int uart_stream_put (char c, FILE *stream)
 {
-  u_init (&uart_rxd);
+  uart_putc (c);
+  return 0;
+}
 
-  const uint8_t idx = sw_baudrate () % LENGTH(baudrates);
-  UBRRL = baudrates[idx][1];
-  UBRRH = baudrates[idx][0];
-  UCSRA &= ~_BV(U2X);
 
-  // UART Receiver und Transmitter anschalten
-  UCSRB = _BV(RXEN) | _BV(TXEN);
+static FILE uart_stream;
 
-  uint8_t ucsrc = _BV(URSEL);
-  switch (sw_stopbits ())
-  {
-    default:
-      break;
-
-    case 2:
-      ucsrc |= _BV(USBS);
-      break;
-  };
-  switch (sw_databits ())
-  {
-    default:
-      ucsrc |= _BV(UCSZ1) | _BV(UCSZ0);
-      break;
+/* statische Puffer, fuer das Kommando mem */
+const __flash uint16_t uart_ram = sizeof uart_rxd + sizeof uart_txd + sizeof uart_stream;
 
-    case 7:
-      ucsrc |= _BV(UCSZ1);
-      break;
-  };
-  switch (sw_parity ())
-  {
-    default:
-      break;
 
-    case even:
-      ucsrc |= _BV(UPM1);
-      break;
+void uart_init (void)
+{
+  u_init (&uart_rxd);
+  u_init (&uart_txd);
+  uart_tx_limit = 0;
+  fdev_setup_stream (&uart_stream, uart_stream_put, NULL, _FDEV_SETUP_WRITE);
+  hal_uart_init (sw_baudrate (), sw_databits (), sw_stopbits (), sw_parity ());
+}
 
-    case odd:
-      ucsrc |= _BV(UPM0) | _BV(UPM1);
-      break;
-  };
-  UCSRC = ucsrc;
 
-  // Flush Receive-Buffer
-  do
+void uart_puts (const char *s)
+{
+  while (*s)
   {
-    UDR;
+    uart_putc (*s++);
   }
-  while (UCSRA & _BV(RXC));
 }
 
 
-void uart_puts (const char *s)
+void uart_write (const char *s, uint8_t n)
 {
-  while (*s)
+  while (n--)
   {
     uart_putc (*s++);
   }
@@ -313,11 +313,9 @@ void uart_putsln_P (const __flash char *s)
 }
 
 
-void uart_vsnprintf_P (const __flash char *fmt, va_list ap)
+void uart_vprintf_P (const __flash char *fmt, va_list ap)
 {
-  char temp[128];
-  vsnprintf_P (temp, sizeof temp, fmt, ap);
-  uart_puts (temp);
+  vfprintf_P (&uart_stream, fmt, ap);
 }
 
 
@@ -325,6 +323,6 @@ void uart_printf_P (const __flash char *fmt, ...)
 {
   va_list ap;
   va_start (ap, fmt);
-  uart_vsnprintf_P (fmt, ap);
+  uart_vprintf_P (fmt, ap);
   va_end (ap);
 }
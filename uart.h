@@ -12,12 +12,22 @@
 #include <stdarg.h>
 
 
+extern long uart_count_rxc;
+extern long uart_count_fe;
+extern long uart_count_dor;
+extern long uart_count_pe;
+extern long uart_count_overrun;
+extern const __flash uint16_t uart_ram;
+
 extern void (*uart_sleep) (void);
 extern void (*uart_inevent) (uint8_t c);
 extern int uart_getc_nowait (void);
 extern uint8_t uart_getc (void);
 extern bool uart_putc_nowait (uint8_t c);
 extern void uart_putc (uint8_t c);
+extern void uart_hold (bool on);
+extern void uart_release (void);
+extern void uart_discard (void);
 extern void uart_drain ();
 extern void uart_flush ();
 extern int uart_in_peek (void);
@@ -27,12 +37,13 @@ extern uint16_t uart_out_avail ();
 extern void uart_init (void);
 
 extern void uart_puts (const char *s);
+extern void uart_write (const char *s, uint8_t n);
 extern void uart_puts_P (const __flash char *s);
 extern void uart_bs (void);
 extern void uart_crlf (void);
 extern void uart_putsln (const char *s);
 extern void uart_putsln_P (const __flash char *s);
-extern void uart_vsnprintf_P (const __flash char *fmt, va_list ap);
+extern void uart_vprintf_P (const __flash char *fmt, va_list ap);
 extern void uart_printf_P (const __flash char *fmt, ...);
 
 #endif
@@ -0,0 +1,185 @@
+/*
+ * $Header$
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/eeprom.h>
+
+#include "common.h"
+#include "telegram.h"
+#include "calendar.h"
+#include "vote.h"
+
+
+/*
+ * Plausibilitaet der dekodierten Minuten.  Die Paritaet erkennt keine
+ * geraden Bitfehler, deshalb muss jeder Rahmen die BCD-Bereiche
+ * einhalten und in die letzten Rahmen passen: der Ring haelt die
+ * letzten VOTE_N plausiblen Rahmen mit ihrem Alter in Minuten, jeder
+ * davon sagt mit calendar_inc_min() die laufende Minute voraus.  Ein
+ * Rahmen wird angenommen, wenn er mit vote_frames - 1 Vorhersagen
+ * uebereinstimmt; vote_frames = 1 prueft nur die Bereiche.
+ */
+
+
+#ifndef VOTE_FRAMES
+#define VOTE_FRAMES     2
+#endif
+
+/* aeltere Rahmen sagen nichts mehr voraus */
+#define VOTE_MAX_AGE    10
+
+
+static uint8_t ee_vote_frames EEMEM = UINT8_MAX;
+
+uint8_t vote_frames;
+long vote_accepted, vote_range, vote_disagree;
+
+static struct
+{
+  struct TimeInfo ti;
+  uint8_t age;
+}
+ring[VOTE_N];
+static uint8_t ring_next;
+
+const __flash uint16_t vote_ram = sizeof ring;
+
+
+/* zwei BCD-Ziffern im Bereich lo..hi */
+static bool bcd_ok (const char *digits, uint8_t lo, uint8_t hi)
+{
+  const uint8_t d0 = digits[0] - '0', d1 = digits[1] - '0';
+
+  if (d0 > 9 || d1 > 9)
+  {
+    return false;
+  };
+
+  const uint8_t v = d0 * 10 + d1;
+  return lo <= v && v <= hi;
+}
+
+
+static bool range_ok (const struct TimeInfo *ti)
+{
+  return bcd_ok (ti->min, 0, 59)
+         &&
+         bcd_ok (ti->hr, 0, 23)
+         &&
+         bcd_ok (ti->day, 1, 31)
+         &&
+         ti->wday[0] >= '1' && ti->wday[0] <= '7'
+         &&
+         bcd_ok (ti->mon, 1, 12)
+         &&
+         bcd_ok (ti->yr, 0, 99);
+}
+
+
+/* Zeitfelder und Zeitzone, die Ankuendigungen duerfen abweichen */
+static bool same_time (const struct TimeInfo *a, const struct TimeInfo *b)
+{
+  return memcmp (a->min, b->min, 2) == 0
+         &&
+         memcmp (a->hr, b->hr, 2) == 0
+         &&
+         memcmp (a->day, b->day, 2) == 0
+         &&
+         a->wday[0] == b->wday[0]
+         &&
+         memcmp (a->mon, b->mon, 2) == 0
+         &&
+         memcmp (a->yr, b->yr, 2) == 0
+         &&
+         a->cest == b->cest;
+}
+
+
+bool vote_set_frames (uint8_t n)
+{
+  if (n < 1 || n > VOTE_N + 1)
+  {
+    return false;
+  };
+  vote_frames = n;
+  return true;
+}
+
+
+void vote_store (void)
+{
+  eeprom_update_byte (&ee_vote_frames, vote_frames);
+}
+
+
+void vote_clear_stat (void)
+{
+  vote_accepted = vote_range = vote_disagree = 0;
+}
+
+
+void vote_init (void)
+{
+  if (!vote_set_frames (eeprom_read_byte (&ee_vote_frames)))
+  {
+    vote_set_frames (VOTE_FRAMES);
+  };
+  for (uint8_t i = 0; i < VOTE_N; ++i)
+  {
+    ring[i].age = UINT8_MAX;
+  }
+}
+
+
+/* einmal je Minute, ti == NULL: kein Rahmen empfangen */
+bool vote_frame (const struct TimeInfo *ti)
+{
+  uint8_t votes = 0;
+
+  for (uint8_t i = 0; i < VOTE_N; ++i)
+  {
+    if (ring[i].age < UINT8_MAX)
+    {
+      ++ring[i].age;
+    };
+
+    if (ti && ring[i].age <= VOTE_MAX_AGE)
+    {
+      struct TimeInfo predicted = ring[i].ti;
+
+      for (uint8_t m = ring[i].age; m > 0; --m)
+      {
+        calendar_inc_min (&predicted);
+      };
+      votes += same_time (&predicted, ti);
+    }
+  };
+
+  if (!ti)
+  {
+    return false;
+  };
+
+  if (!range_ok (ti))
+  {
+    ++vote_range;
+    return false;
+  };
+
+  /* auch abweichende Rahmen merken, sonst faengt sich der Ring nach einem Sprung nicht */
+  ring[ring_next].ti = *ti;
+  ring[ring_next].age = 0;
+  ring_next = (ring_next + 1) % VOTE_N;
+
+  if (votes + 1 < vote_frames)
+  {
+    ++vote_disagree;
+    return false;
+  };
+  ++vote_accepted;
+  return true;
+}
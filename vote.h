@@ -0,0 +1,31 @@
+/*
+ * $Header$
+ */
+
+
+#ifndef _VOTE_H
+#define _VOTE_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "telegram.h"
+
+
+/* so viele Rahmen im Ring */
+#define VOTE_N          4
+
+
+extern uint8_t vote_frames;
+extern long vote_accepted, vote_range, vote_disagree;
+extern const __flash uint16_t vote_ram;
+
+extern void vote_init (void);
+extern bool vote_set_frames (uint8_t n);
+extern void vote_store (void);
+extern void vote_clear_stat (void);
+extern bool vote_frame (const struct TimeInfo *ti);
+
+
+#endif